@@ -28,13 +28,19 @@
 #include "or1kiss/bitops.h"
 
 #include "or1kiss/endian.h"
+#include "or1kiss/monitor.h"
 #include "or1kiss/env.h"
 #include "or1kiss/mmu.h"
+#include "or1kiss/cache.h"
 #include "or1kiss/spr.h"
 #include "or1kiss/tick.h"
+#include "or1kiss/event.h"
 #include "or1kiss/insn.h"
 #include "or1kiss/decode.h"
 #include "or1kiss/disasm.h"
+#include "or1kiss/logfile.h"
+#include "or1kiss/memtrace.h"
+#include "or1kiss/replay.h"
 
 #include "or1kiss/elf.h"
 #include "or1kiss/rsp.h"
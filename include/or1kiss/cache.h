@@ -0,0 +1,146 @@
+/******************************************************************************
+ *                                                                            *
+ * Copyright 2018 Jan Henrik Weinstock                                        *
+ *                                                                            *
+ * Licensed under the Apache License, Version 2.0 (the "License");            *
+ * you may not use this file except in compliance with the License.           *
+ * You may obtain a copy of the License at                                    *
+ *                                                                            *
+ *     http://www.apache.org/licenses/LICENSE-2.0                             *
+ *                                                                            *
+ * Unless required by applicable law or agreed to in writing, software        *
+ * distributed under the License is distributed on an "AS IS" BASIS,          *
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.   *
+ * See the License for the specific language governing permissions and        *
+ * limitations under the License.                                             *
+ *                                                                            *
+ ******************************************************************************/
+
+#ifndef OR1KISS_CACHE_H
+#define OR1KISS_CACHE_H
+
+#include "or1kiss/includes.h"
+#include "or1kiss/types.h"
+#include "or1kiss/utils.h"
+#include "or1kiss/exception.h"
+#include "or1kiss/bitops.h"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#define OR1KISS_CACHE_MAX_WAYS (128)
+#define OR1KISS_CACHE_MAX_SETS (32768)
+
+namespace or1kiss {
+
+enum cache_config {
+    CCFGR_NCW    = 7 << 0,   // Number of cache ways (log2)
+    CCFGR_NCS    = 15 << 3,  // Number of cache sets (log2)
+    CCFGR_CBS    = 1 << 7,   // Cache block size (0: 16 bytes, 1: 32 bytes)
+    CCFGR_CWS    = 1 << 8,   // Cache write strategy (0: write-through)
+    CCFGR_CCRI   = 1 << 9,   // Cache control register implemented
+    CCFGR_CBIRI  = 1 << 10,  // Cache block invalidate register implemented
+    CCFGR_CBPRI  = 1 << 11,  // Cache block prefetch register implemented
+    CCFGR_CBLRI  = 1 << 12,  // Cache block lock register implemented
+    CCFGR_CBFRI  = 1 << 13,  // Cache block flush register implemented
+    CCFGR_CBWBRI = 1 << 14,  // Cache block write-back register implemented
+};
+
+// Timing model of a set-associative, write-through cache without write
+// allocation. Only tags are kept, data always comes from memory. Each set
+// holds its tags ordered from most to least recently used, a tag is the
+// block address with bit 0 set to mark it valid.
+class cache
+{
+private:
+    u32 m_cfg;
+    u32 m_num_sets;
+    u32 m_num_ways;
+    u32 m_stride;
+    u32 m_set_mask;
+    u32 m_block_bits;
+    u32 m_penalty;
+    u32 m_last;
+    vector<u32> m_tags;
+
+    u64 m_hits;
+    u64 m_misses;
+
+    u32 make_tag(u32 addr) const;
+    u32* lookup_set(u32 tag);
+    u32 find_way(const u32* set, u32 tag) const;
+
+    u32 refill(u32 tag);
+    void update(u32 tag);
+
+public:
+    cache();
+    virtual ~cache();
+
+    cache(const cache&) = delete;
+
+    bool is_enabled() const { return m_num_ways > 0; }
+
+    u32 get_cfgr() const { return m_cfg; }
+    u32 get_num_sets() const { return m_num_sets; }
+    u32 get_num_ways() const { return m_num_ways; }
+    u32 get_block_size() const { return 1u << m_block_bits; }
+    u32 get_size() const;
+    u32 get_miss_penalty() const { return m_penalty; }
+
+    u64 get_num_hits() const { return m_hits; }
+    u64 get_num_misses() const { return m_misses; }
+    float get_hit_rate() const;
+
+    void configure(u32 size, u32 ways, u32 block, u32 penalty);
+
+    u32 read(u32 addr);
+    void write(u32 addr);
+
+    void invalidate(u32 addr);
+    void invalidate_all();
+};
+
+inline u32 cache::make_tag(u32 addr) const {
+    return (addr >> m_block_bits << m_block_bits) | 1;
+}
+
+inline u32* cache::lookup_set(u32 tag) {
+    return &m_tags[((tag >> m_block_bits) & m_set_mask) * m_stride];
+}
+
+inline u32 cache::get_size() const {
+    return m_num_sets * m_num_ways << m_block_bits;
+}
+
+inline float cache::get_hit_rate() const {
+    u64 total = m_hits + m_misses;
+    return total ? (float)m_hits / (float)total : 0.0f;
+}
+
+// Returns the number of extra cycles needed to complete the read. Repeated
+// accesses to the same block skip the tag lookup entirely.
+inline u32 cache::read(u32 addr) {
+    u32 tag = make_tag(addr);
+    if (likely(tag == m_last)) {
+        m_hits++;
+        return 0;
+    }
+
+    return refill(tag);
+}
+
+inline void cache::write(u32 addr) {
+    u32 tag = make_tag(addr);
+    if (likely(tag == m_last)) {
+        m_hits++;
+        return;
+    }
+
+    update(tag);
+}
+
+} // namespace or1kiss
+
+#endif
@@ -29,6 +29,9 @@ namespace or1kiss {
 void disassemble(ostream& os, u32 insn);
 string disassemble(u32 insn);
 
+const char* opcode_name(opcode op);
+opcode find_opcode(const string& name);
+
 } // namespace or1kiss
 
 #endif
@@ -66,6 +66,7 @@ private:
     std::string m_name;
     unsigned char* m_data;
     unsigned int m_size;
+    u64 m_offset;
 
     u64 m_virt_addr;
     u64 m_phys_addr;
@@ -73,6 +74,7 @@ private:
     bool m_flag_alloc;
     bool m_flag_write;
     bool m_flag_exec;
+    bool m_flag_nobits;
 
     // Disable
     elf_section();
@@ -82,10 +84,12 @@ public:
     bool needs_alloc() const { return m_flag_alloc; }
     bool is_writeable() const { return m_flag_write; }
     bool is_executable() const { return m_flag_exec; }
+    bool is_nobits() const { return m_flag_nobits; }
 
     const std::string& get_name() const { return m_name; }
     void* get_data() const { return m_data; }
     unsigned int get_size() const { return m_size; }
+    u64 get_file_offset() const { return m_offset; }
 
     u64 get_virt_addr() const { return m_virt_addr; }
     u64 get_phys_addr() const { return m_phys_addr; }
@@ -101,7 +105,7 @@ public:
     elf_section(Elf* elf, Elf_Scn* section);
     virtual ~elf_section();
 
-    void load(env* e, bool verbose = false);
+    void load(env* e, bool verbose = false, int fd = -1);
 };
 
 class elf
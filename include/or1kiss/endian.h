@@ -83,6 +83,50 @@ inline void* memcpyswp(void* to, const void* from, unsigned int size) {
     return to;
 }
 
+// In a word swapped memory layout, each aligned 32bit word is stored in the
+// opposite byte order, e.g. host byte order for a big endian system on a
+// little endian host. Aligned words are then accessed as is, while bytes and
+// halfwords are found at the XOR'd address computed by word_swizzle. Since
+// the layout works on host pointers, memory must be allocated word aligned.
+template <typename T>
+inline T* word_swizzle(T* ptr, unsigned int size) {
+    return (T*)((uintptr_t)ptr ^ ((4 - size) & 3));
+}
+
+// copy size bytes out of word swapped memory, starting at from
+inline void memcpy_from_words(void* to, const u8* from, size_t size) {
+    u8* dst = (u8*)to;
+    for (; size > 0 && ((uintptr_t)from & 3); size--)
+        *dst++ = *word_swizzle(from++, 1);
+
+    for (; size > 3; size -= 4, from += 4, dst += 4) {
+        u32 word;
+        memcpy(&word, from, sizeof(word));
+        word = byte_swap(word);
+        memcpy(dst, &word, sizeof(word));
+    }
+
+    for (; size > 0; size--)
+        *dst++ = *word_swizzle(from++, 1);
+}
+
+// copy size bytes into word swapped memory, starting at to
+inline void memcpy_to_words(u8* to, const void* from, size_t size) {
+    const u8* src = (const u8*)from;
+    for (; size > 0 && ((uintptr_t)to & 3); size--)
+        *word_swizzle(to++, 1) = *src++;
+
+    for (; size > 3; size -= 4, to += 4, src += 4) {
+        u32 word;
+        memcpy(&word, src, sizeof(word));
+        word = byte_swap(word);
+        memcpy(to, &word, sizeof(word));
+    }
+
+    for (; size > 0; size--)
+        *word_swizzle(to++, 1) = *src++;
+}
+
 } // namespace or1kiss
 
 #endif
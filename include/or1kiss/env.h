@@ -25,9 +25,14 @@
 #include "or1kiss/exception.h"
 #include "or1kiss/bitops.h"
 #include "or1kiss/endian.h"
+#include "or1kiss/monitor.h"
+
+#define OR1KISS_TRANSFER_CHUNK (4096)
 
 namespace or1kiss {
 
+class decode_cache;
+
 enum response {
     RESP_SUCCESS = 0, // OK response
     RESP_FAILED  = 1, // access failed: not atomic
@@ -58,6 +63,8 @@ private:
 
     endian m_endian;
 
+    u32 m_core_id;
+
 public:
     mutable u64 cycles;
     u32 addr;
@@ -106,6 +113,9 @@ public:
 
     bool is_big_endian() const { return m_endian == ENDIAN_BIG; }
 
+    u32 get_core_id() const { return m_core_id; }
+    void set_core_id(u32 id) { m_core_id = id; }
+
     bool is_aligned() const { return or1kiss::is_aligned(addr, size); }
 
     void set_addr_and_data(u32 tx_addr, void* tx_data, unsigned int tx_size) {
@@ -144,6 +154,7 @@ inline request::request():
     m_cache_writeback(false),
     m_weakly_ordered(false),
     m_endian(host_endian()),
+    m_core_id(0),
     cycles(0),
     addr(0),
     data(NULL),
@@ -162,6 +173,7 @@ inline request::request(const request& other):
     m_cache_writeback(other.m_cache_writeback),
     m_weakly_ordered(other.m_weakly_ordered),
     m_endian(other.m_endian),
+    m_core_id(other.m_core_id),
     cycles(other.cycles),
     addr(other.addr),
     data(other.data),
@@ -173,6 +185,7 @@ class env
 {
 private:
     endian m_endian;
+    bool m_dmi_swapped;
 
     unsigned char* m_data_ptr;
     u32 m_data_start;
@@ -184,14 +197,36 @@ private:
     u32 m_insn_end;
     u64 m_insn_cycles;
 
-    u32 m_excl_addr;
-    u32 m_excl_data;
+    monitor m_default_monitor;
+    monitor* m_monitor;
+
+    vector<decode_cache*> m_decode_caches;
 
     response exclusive_access(unsigned char* ptr, request& req);
+    response swapped_access(unsigned char* ptr, request& req);
+    unsigned char* direct_memory_ptr(request& req, u64& size) const;
 
 public:
     endian get_system_endian() const { return m_endian; }
 
+    // Each environment has its own exclusive monitor. Environments that
+    // share memory, e.g. one per core, must also share a monitor for
+    // l.lwa/l.swa to work across cores; pass NULL to revert to the default.
+    monitor* get_monitor() const { return m_monitor; }
+    void set_monitor(monitor* mon);
+
+    // Environments may store DMI memory word swapped (see word_swizzle),
+    // so that aligned words need no conversion when system and host
+    // endianess differ. Otherwise, this setting has no effect. Memory must
+    // be empty when switching layouts and DMI regions word aligned.
+    bool is_dmi_swapped() const { return m_dmi_swapped; }
+    void set_dmi_swapped(bool set = true);
+
+    // Decode caches attached here are invalidated whenever transfer_block
+    // writes to memory. Processors attach their cache upon construction.
+    void attach(decode_cache* cache);
+    void detach(decode_cache* cache);
+
     inline void set_data_ptr(unsigned char* ptr, u32 addr_start = 0x00000000,
                              u32 addr_end = 0xffffffff, u64 cycles = 0);
 
@@ -201,6 +236,9 @@ public:
     inline unsigned char* get_data_ptr(u32 addr) const;
     inline unsigned char* get_insn_ptr(u32 addr) const;
 
+    u64 get_data_cycles() const { return m_data_cycles; }
+    u64 get_insn_cycles() const { return m_insn_cycles; }
+
     inline unsigned char* direct_memory_ptr(request& req) const;
 
     // Specify the endianess in which you want to receive data from the ISS
@@ -214,8 +252,21 @@ public:
 
     virtual u64 sleep(u64 cycles) { return 0; }
     virtual response transact(const request& req) = 0;
+
+    // Environments backed by host memory may map file contents directly
+    // into the simulated address space, e.g. when loading ELF sections.
+    // Returning false makes the caller fall back to regular transactions.
+    virtual bool map_file(int fd, u64 offset, u32 addr, u64 size) {
+        return false;
+    }
     response convert_and_transact(request& req);
 
+    // Copies a block of req.size bytes between simulation memory and the
+    // buffer at req.data without any endianess conversion. Uses memcpy on
+    // DMI regions and transactions of up to OR1KISS_TRANSFER_CHUNK bytes
+    // everywhere else.
+    response transfer_block(request& req);
+
     template <typename T>
     inline bool read(u32 addr, T& val);
 
@@ -235,6 +286,14 @@ public:
     inline bool write_dbg(u32 addr, const T& val);
 };
 
+inline void env::set_monitor(monitor* mon) {
+    m_monitor = mon ? mon : &m_default_monitor;
+}
+
+inline void env::set_dmi_swapped(bool set) {
+    m_dmi_swapped = set && (m_endian != host_endian());
+}
+
 inline void env::set_data_ptr(unsigned char* ptr, u32 start, u32 end,
                               u64 cycles) {
     if (start > end)
@@ -0,0 +1,95 @@
+/******************************************************************************
+ *                                                                            *
+ * Copyright 2018 Jan Henrik Weinstock                                        *
+ *                                                                            *
+ * Licensed under the Apache License, Version 2.0 (the "License");            *
+ * you may not use this file except in compliance with the License.           *
+ * You may obtain a copy of the License at                                    *
+ *                                                                            *
+ *     http://www.apache.org/licenses/LICENSE-2.0                             *
+ *                                                                            *
+ * Unless required by applicable law or agreed to in writing, software        *
+ * distributed under the License is distributed on an "AS IS" BASIS,          *
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.   *
+ * See the License for the specific language governing permissions and        *
+ * limitations under the License.                                             *
+ *                                                                            *
+ ******************************************************************************/
+
+#ifndef OR1KISS_EVENT_H
+#define OR1KISS_EVENT_H
+
+#include "or1kiss/includes.h"
+#include "or1kiss/types.h"
+#include "or1kiss/utils.h"
+#include "or1kiss/exception.h"
+
+namespace or1kiss {
+
+// Handlers receive the current cycle count, which may lie a few cycles past
+// the scheduled one, since instructions are never interrupted.
+typedef std::function<void(u64 cycle)> event_handler;
+
+// Per-core queue of timed events, kept as a binary min-heap of event ids.
+// Events are created once and can then be scheduled, moved and cancelled
+// any number of times. The processor only simulates up to the earliest
+// scheduled event before running due handlers, which may schedule their
+// events again. Queues are not thread-safe; only use them from the thread
+// simulating the owning processor.
+class event_queue
+{
+private:
+    struct event {
+        event_handler handler;
+        u64 cycle;
+        size_t pos; // index into m_heap or npos if not scheduled
+    };
+
+    static const size_t npos = ~(size_t)0;
+
+    vector<event> m_events;
+    vector<u32> m_heap;
+    vector<u32> m_free;
+
+    bool before(size_t a, size_t b) const;
+    void place(size_t pos, u32 id);
+    void sift_up(size_t pos);
+    void sift_down(size_t pos);
+    void remove(size_t pos);
+
+public:
+    event_queue();
+    virtual ~event_queue();
+
+    event_queue(const event_queue&) = delete;
+
+    bool empty() const { return m_heap.empty(); }
+    u64 next() const;
+
+    u32 create(const event_handler& handler);
+    void destroy(u32 id);
+
+    bool is_scheduled(u32 id) const;
+    u64 get_cycle(u32 id) const;
+
+    void schedule(u32 id, u64 cycle);
+    void cancel(u32 id);
+
+    void run(u64 cycle);
+};
+
+inline u64 event_queue::next() const {
+    return m_heap.empty() ? ~0ull : m_events[m_heap[0]].cycle;
+}
+
+inline bool event_queue::is_scheduled(u32 id) const {
+    return id < m_events.size() && m_events[id].pos != npos;
+}
+
+inline u64 event_queue::get_cycle(u32 id) const {
+    return is_scheduled(id) ? m_events[id].cycle : ~0ull;
+}
+
+} // namespace or1kiss
+
+#endif
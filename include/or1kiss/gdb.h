@@ -60,6 +60,7 @@ private:
 
     void warning(const char* text, ...);
 
+    response mem_transfer(request& req);
     void mem_read(u32 phys_addr, void* ptr, unsigned int size);
     void mem_write(u32 phys_addr, void* ptr, unsigned int size);
 
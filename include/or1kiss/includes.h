@@ -33,6 +33,9 @@
 #include <exception>
 #include <limits>
 #include <map>
+#include <unordered_set>
+#include <atomic>
+#include <functional>
 
 #include <cstdlib>
 #include <cstdio>
@@ -47,6 +50,7 @@
 #include <fenv.h>
 #include <fcntl.h>
 #include <errno.h>
+#include <time.h>
 #include <signal.h>
 #include <sys/types.h>
 #include <sys/time.h>
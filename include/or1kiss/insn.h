@@ -38,6 +38,7 @@ typedef struct instruction {
     u32* src1;
     u32* src2;
     u32 imm;
+    u32 stall; // cycles needed beyond the first one
 } instruction;
 
 enum decode_cache_size {
@@ -69,6 +70,8 @@ private:
     decode_cache_size m_size;
     unsigned int m_mask;
     unsigned int m_count;
+    unsigned int m_first; // lowest entry filled since invalidate_all
+    unsigned int m_last;  // highest entry filled since invalidate_all
     instruction* m_cache;
 
 public:
@@ -79,16 +82,27 @@ public:
     virtual ~decode_cache();
 
     instruction& lookup(u32 addr);
+    void touch(u32 addr);
 
     void invalidate(u32 addr);
     void invalidate_block(u32 addr, u32 size);
     void invalidate_all();
+
+    // Overrides exec of all entries at addresses congruent to addr modulo
+    // size, which must be a power of two.
+    void retarget(u32 addr, u32 size, execute_function exec);
 };
 
 inline instruction& decode_cache::lookup(u32 addr) {
     return m_cache[(addr >> 2) & m_mask];
 }
 
+inline void decode_cache::touch(u32 addr) {
+    unsigned int idx = (addr >> 2) & m_mask;
+    m_first          = min(m_first, idx);
+    m_last           = max(m_last, idx);
+}
+
 inline void decode_cache::invalidate(u32 addr) {
     instruction& insn = lookup(addr);
     if (insn.addr == addr)
@@ -96,12 +110,38 @@ inline void decode_cache::invalidate(u32 addr) {
 }
 
 inline void decode_cache::invalidate_block(u32 addr, u32 size) {
+    // Blocks larger than the cache itself touch every entry anyway
+    if ((size >> 2) >= m_count) {
+        invalidate_all();
+        return;
+    }
+
     for (unsigned int off = 0; off < size; off += 4)
         invalidate(addr + off);
 }
 
 inline void decode_cache::invalidate_all() {
-    memset(m_cache, 0xff, m_count * sizeof(instruction));
+    // Only clear the entries that have been filled, most programs touch
+    // just a small part of large caches.
+    if (m_first <= m_last) {
+        memset(m_cache + m_first, 0xff,
+               (m_last - m_first + 1) * sizeof(instruction));
+    }
+
+    m_first = m_count;
+    m_last  = 0;
+}
+
+inline void decode_cache::retarget(u32 addr, u32 size,
+                                   execute_function exec) {
+    // Congruent addresses are step entries apart, or share one entry
+    unsigned int step = min(size >> 2, m_count);
+    for (unsigned int idx = (addr >> 2) & (step - 1); idx < m_count;
+         idx += step) {
+        instruction& insn = m_cache[idx];
+        if ((insn.addr != ~0u) && !((insn.addr ^ addr) & (size - 1)))
+            insn.exec = exec;
+    }
 }
 
 } // namespace or1kiss
@@ -0,0 +1,68 @@
+/******************************************************************************
+ *                                                                            *
+ * Copyright 2018 Jan Henrik Weinstock                                        *
+ *                                                                            *
+ * Licensed under the Apache License, Version 2.0 (the "License");            *
+ * you may not use this file except in compliance with the License.           *
+ * You may obtain a copy of the License at                                    *
+ *                                                                            *
+ *     http://www.apache.org/licenses/LICENSE-2.0                             *
+ *                                                                            *
+ * Unless required by applicable law or agreed to in writing, software        *
+ * distributed under the License is distributed on an "AS IS" BASIS,          *
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.   *
+ * See the License for the specific language governing permissions and        *
+ * limitations under the License.                                             *
+ *                                                                            *
+ ******************************************************************************/
+
+#ifndef OR1KISS_LOGFILE_H
+#define OR1KISS_LOGFILE_H
+
+#include "or1kiss/includes.h"
+#include "or1kiss/types.h"
+#include "or1kiss/utils.h"
+
+namespace or1kiss {
+
+// Binary log files, i.e. memory traces and replay logs, start with this
+// header and mostly hold LEB128 style varints: seven bits per byte, least
+// significant first, with bit 7 set on all but the last byte.
+struct logfile_header {
+    char magic[8]; // identifies the kind of file
+    u32 version;   // format version of that kind
+    u32 reserved;
+};
+
+bool write_logfile_header(FILE* file, const char* magic, u32 version);
+bool read_logfile_header(FILE* file, const char* magic, u32& version);
+
+inline void put_varint(vector<u8>& buf, u64 val) {
+    while (val >= 0x80) {
+        buf.push_back((u8)val | 0x80);
+        val >>= 7;
+    }
+
+    buf.push_back((u8)val);
+}
+
+// Reads from next_byte, which returns the next byte or EOF once exhausted
+template <typename SOURCE>
+inline bool get_varint(SOURCE next_byte, u64& val) {
+    val = 0;
+    for (unsigned int shift = 0; shift < 64; shift += 7) {
+        int byte = next_byte();
+        if (byte == EOF)
+            return false;
+
+        val |= (u64)(byte & 0x7f) << shift;
+        if (!(byte & 0x80))
+            return true;
+    }
+
+    return false;
+}
+
+} // namespace or1kiss
+
+#endif
@@ -0,0 +1,114 @@
+/******************************************************************************
+ *                                                                            *
+ * Copyright 2018 Jan Henrik Weinstock                                        *
+ *                                                                            *
+ * Licensed under the Apache License, Version 2.0 (the "License");            *
+ * you may not use this file except in compliance with the License.           *
+ * You may obtain a copy of the License at                                    *
+ *                                                                            *
+ *     http://www.apache.org/licenses/LICENSE-2.0                             *
+ *                                                                            *
+ * Unless required by applicable law or agreed to in writing, software        *
+ * distributed under the License is distributed on an "AS IS" BASIS,          *
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.   *
+ * See the License for the specific language governing permissions and        *
+ * limitations under the License.                                             *
+ *                                                                            *
+ ******************************************************************************/
+
+#ifndef OR1KISS_MEMTRACE_H
+#define OR1KISS_MEMTRACE_H
+
+#include "or1kiss/includes.h"
+#include "or1kiss/types.h"
+#include "or1kiss/utils.h"
+#include "or1kiss/exception.h"
+#include "or1kiss/bitops.h"
+#include "or1kiss/logfile.h"
+
+#define OR1KISS_MEMTRACE_MAGIC   "OR1KMTRC"
+#define OR1KISS_MEMTRACE_VERSION (1)
+#define OR1KISS_MEMTRACE_BLOCK   (64 * 1024)
+
+namespace or1kiss {
+
+// A memory trace file starts with a memtrace_header, followed by blocks of
+// records. Each block starts with its raw and stored size (both u32) and is
+// zlib compressed unless both sizes are equal. Records are delta encoded
+// against their predecessor within the same block, so every block can be
+// decoded on its own:
+//   u8     flags: log2(size) in bits 0..1, MEMTRACE_WRITE, MEMTRACE_EXCL,
+//                 MEMTRACE_SUPER
+//   varint cycles elapsed since the previous record
+//   varint zigzag encoded difference to the previous address
+//   varint value, zero extended to 64 bits
+enum memtrace_flags {
+    MEMTRACE_SIZE  = 3 << 0, // log2 of access size
+    MEMTRACE_WRITE = 1 << 2, // write access
+    MEMTRACE_EXCL  = 1 << 3, // exclusive access (l.lwa/l.swa)
+    MEMTRACE_SUPER = 1 << 4, // supervisor mode access
+};
+
+typedef logfile_header memtrace_header;
+
+struct memtrace_record {
+    u64 cycle;
+    u32 addr;
+    u32 size;
+    u64 value;
+    bool write;
+    bool excl;
+    bool super;
+};
+
+class memtrace_writer
+{
+private:
+    FILE* m_file;
+    bool m_compress;
+    u64 m_cycle;
+    u32 m_addr;
+    u64 m_records;
+    vector<u8> m_block;
+    vector<u8> m_buffer;
+
+    void flush_block();
+
+public:
+    u64 get_num_records() const { return m_records; }
+
+    memtrace_writer(const string& filename, bool compress = true);
+    virtual ~memtrace_writer();
+
+    memtrace_writer()                       = delete;
+    memtrace_writer(const memtrace_writer&) = delete;
+
+    void record(const memtrace_record& rec);
+    void flush();
+};
+
+class memtrace_reader
+{
+private:
+    FILE* m_file;
+    u64 m_cycle;
+    u32 m_addr;
+    size_t m_pos;
+    vector<u8> m_block;
+    vector<u8> m_buffer;
+
+    bool next_block();
+
+public:
+    memtrace_reader(const string& filename);
+    virtual ~memtrace_reader();
+
+    memtrace_reader()                       = delete;
+    memtrace_reader(const memtrace_reader&) = delete;
+
+    bool next(memtrace_record& rec);
+};
+
+} // namespace or1kiss
+
+#endif
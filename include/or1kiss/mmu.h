@@ -35,6 +35,15 @@
 #define OR1KISS_PAGE_COMPARE(a, b) (!OR1KISS_PAGE_ALIGN((a) ^ (b)))
 #define OR1KISS_MKADDR(pn, off)    (((pn) << OR1KISS_PAGE_BITS) | (off))
 
+// Level 1 page table entries may map 16MB large pages directly
+#define OR1KISS_LARGE_PAGE_BITS         (24)
+#define OR1KISS_LARGE_PAGE_SIZE         (1 << OR1KISS_LARGE_PAGE_BITS)
+#define OR1KISS_LARGE_PAGE_MASK         (OR1KISS_LARGE_PAGE_SIZE - 1)
+#define OR1KISS_LARGE_PAGE_NUMBER(addr) ((addr) >> OR1KISS_LARGE_PAGE_BITS)
+#define OR1KISS_LARGE_PAGE_ALIGN(addr)  ((addr) & ~OR1KISS_LARGE_PAGE_MASK)
+#define OR1KISS_LARGE_PAGE_COMPARE(a, b) \
+    (!OR1KISS_LARGE_PAGE_ALIGN((a) ^ (b)))
+
 #define OR1KISS_TLB_MAX_WAYS (4)
 #define OR1KISS_TLB_MAX_SETS (128)
 #define OR1KISS_TLB_MAX_REGS (2 * OR1KISS_TLB_MAX_SETS * OR1KISS_TLB_MAX_WAYS)
@@ -99,7 +108,7 @@ enum mmu_pte {
     MMUPTE_PPI5 = 5 << 6,
     MMUPTE_PPI6 = 6 << 6,
     MMUPTE_PPI7 = 7 << 6,
-    MMUPTE_L    = 1 << 7,  // Last/Linked
+    MMUPTE_L    = 1 << 9,  // Last, only honored with large pages enabled
     MMUPTE_EXEC = 1 << 10, // not in spec, but enforced by linux
 };
 
@@ -132,9 +141,12 @@ private:
     u32 m_num_ways;
     u32 m_set_mask;
     u32 m_tlb[OR1KISS_TLB_MAX_REGS];
+    bool m_large_pages;
     env* m_env;
 
     int find_empty_way(int set) const;
+    u32* find_entry(u32 addr);
+    bool read_pte(const request& req, u32 addr, u32& pte, u64& cycles);
 
 public:
     mmu(u32, env*);
@@ -153,6 +165,12 @@ public:
     void set_cr(u32 val);
     void set_pr(u32 val);
 
+    // Linux keeps SWE in bit 9 of its page table entries, which is where the
+    // spec puts the L bit. Level 1 large pages therefore have to be turned
+    // on explicitly for guests that use the page table format of the spec.
+    bool has_large_pages() const { return m_large_pages; }
+    void set_large_pages(bool set) { m_large_pages = set; }
+
     u32 get_atb(u32 regno) const;
     u32 get_tlb(u32 regno) const;
 
@@ -163,6 +181,9 @@ public:
     void flush_tlb_entry(u32 idx);
 
     mmu_result translate(request& req);
+
+    void save_state(ostream& os) const;
+    void restore_state(istream& is);
 };
 
 } // namespace or1kiss
@@ -0,0 +1,99 @@
+/******************************************************************************
+ *                                                                            *
+ * Copyright 2018 Jan Henrik Weinstock                                        *
+ *                                                                            *
+ * Licensed under the Apache License, Version 2.0 (the "License");            *
+ * you may not use this file except in compliance with the License.           *
+ * You may obtain a copy of the License at                                    *
+ *                                                                            *
+ *     http://www.apache.org/licenses/LICENSE-2.0                             *
+ *                                                                            *
+ * Unless required by applicable law or agreed to in writing, software        *
+ * distributed under the License is distributed on an "AS IS" BASIS,          *
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.   *
+ * See the License for the specific language governing permissions and        *
+ * limitations under the License.                                             *
+ *                                                                            *
+ ******************************************************************************/
+
+#ifndef OR1KISS_MONITOR_H
+#define OR1KISS_MONITOR_H
+
+#include <atomic>
+
+#include "or1kiss/includes.h"
+#include "or1kiss/types.h"
+#include "or1kiss/utils.h"
+#include "or1kiss/exception.h"
+
+#define OR1KISS_MONITOR_CORES   (256)
+#define OR1KISS_MONITOR_GRANULE (4)
+#define OR1KISS_MONITOR_INVALID (~0u)
+
+namespace or1kiss {
+
+// The exclusive monitor keeps track of the reservations made by l.lwa for
+// each core. A reservation covers one granule and is lost if any core
+// writes to that granule before l.swa completes. All operations are lock
+// free, so cores simulated on different host threads may share a monitor.
+class monitor
+{
+private:
+    std::atomic<u32> m_addr[OR1KISS_MONITOR_CORES];
+    u32 m_data[OR1KISS_MONITOR_CORES];
+
+    std::atomic<u32> m_active;   // number of valid reservations
+    std::atomic<u32> m_numcores; // highest core id seen plus one
+
+    static u32 granule(u32 addr) {
+        return addr & ~(OR1KISS_MONITOR_GRANULE - 1);
+    }
+
+    void invalidate(u32 core, u32 addr);
+
+public:
+    monitor();
+    virtual ~monitor();
+
+    monitor(const monitor&) = delete;
+
+    bool is_reserved(u32 core) const;
+    u32 get_reservation(u32 core) const;
+
+    void reserve(u32 core, u32 addr, u32 data);
+    void clear(u32 core);
+    void clear_all();
+
+    bool store_conditional(u32 core, u32 addr, void* ptr, u32 data);
+
+    void notify_store(u32 addr, u32 size);
+};
+
+inline bool monitor::is_reserved(u32 core) const {
+    return get_reservation(core) != OR1KISS_MONITOR_INVALID;
+}
+
+inline u32 monitor::get_reservation(u32 core) const {
+    if (core >= OR1KISS_MONITOR_CORES)
+        return OR1KISS_MONITOR_INVALID;
+    return m_addr[core].load(std::memory_order_acquire);
+}
+
+inline void monitor::notify_store(u32 addr, u32 size) {
+    // Fast path: this is called for every store, but reservations are rare
+    if (likely(m_active.load(std::memory_order_acquire) == 0))
+        return;
+
+    u32 first = granule(addr);
+    u32 last  = granule(addr + size - 1);
+    u32 cores = m_numcores.load(std::memory_order_acquire);
+    for (u32 core = 0; core < cores; core++) {
+        u32 resv = m_addr[core].load(std::memory_order_acquire);
+        if ((resv >= first) && (resv <= last))
+            invalidate(core, resv);
+    }
+}
+
+} // namespace or1kiss
+
+#endif
@@ -30,9 +30,17 @@
 #include "or1kiss/endian.h"
 #include "or1kiss/env.h"
 #include "or1kiss/tick.h"
+#include "or1kiss/event.h"
 #include "or1kiss/insn.h"
 #include "or1kiss/mmu.h"
+#include "or1kiss/cache.h"
 #include "or1kiss/spr.h"
+#include "or1kiss/memtrace.h"
+#include "or1kiss/replay.h"
+
+// Size and alignment of the block covered by the write combining buffer
+#define OR1KISS_WCB_SIZE        (32)
+#define OR1KISS_WCB_ALIGN(addr) ((addr) & ~(OR1KISS_WCB_SIZE - 1))
 
 #define OR1KISS_VER  (0x12) // CPU Version (deprecated)
 #define OR1KISS_CFG  (0x00) // Configuration Template (deprecated)
@@ -66,6 +74,12 @@
 // Support for non-maskable interrupts (needed for SMP Linux)
 #define OR1KISS_PIC_NMI (0x3) // IRQ0 and IRQ1 are non-maskable
 
+// Interrupts posted from other threads are picked up at least this often
+#define OR1KISS_PIC_POLL (1024) // cycles
+
+// Real-time pacing sleeps at most this long before checking for interrupts
+#define OR1KISS_RT_SLICE (1000000) // nanoseconds
+
 namespace or1kiss {
 
 enum supervisor_status {
@@ -191,14 +205,16 @@ enum nop_mode {
     NOP_OR1KSIM     = 0xb, // Return non-zero if this a simulation
     NOP_SILENT_EXIT = 0xc, // End of simulation, exit silently
     NOP_HOST_TIME   = 0xd, // Current host time, in milliseconds
-    NOP_PUTS        = 0xe  // Print string
+    NOP_PUTS        = 0xe, // Print string
+    NOP_ROI         = 0x10 // Region of interest reached
 };
 
 enum step_result {
     STEP_OK = 0,     // Quantum step finished regularly
     STEP_EXIT,       // Exit request from software
     STEP_BREAKPOINT, // Quantum step stopped due to breakpoint hit
-    STEP_WATCHPOINT  // Quantum step stopped due to watchpoint hit
+    STEP_WATCHPOINT, // Quantum step stopped due to watchpoint hit
+    STEP_ROI         // Region of interest reached (NOP_ROI)
 };
 
 typedef union _double_register {
@@ -227,6 +243,42 @@ inline bool watchpoint::overlaps(const watchpoint& wp) const {
     return overlaps(wp.addr, wp.size);
 }
 
+// Page granular filter over a set of watchpoints: accesses to pages that
+// hold no watchpoint can be ruled out with a single bit test.
+class watchpoint_filter
+{
+private:
+    vector<u64> m_pages; // one bit per page, empty without watchpoints
+
+    bool test_page(u32 page) const;
+
+public:
+    watchpoint_filter(): m_pages() {}
+
+    bool test(u32 addr, u32 size) const;
+    void rebuild(const vector<watchpoint>& wps);
+};
+
+inline bool watchpoint_filter::test_page(u32 page) const {
+    return m_pages[page / 64] & (1ull << (page % 64));
+}
+
+inline bool watchpoint_filter::test(u32 addr, u32 size) const {
+    if (m_pages.empty())
+        return false;
+
+    // Ranges wrapping past the top of the address space are cut off there
+    u64 end   = min((u64)addr + max(size, 1u) - 1, (u64)~0u);
+    u32 first = OR1KISS_PAGE_NUMBER(addr);
+    u32 last  = OR1KISS_PAGE_NUMBER((u32)end);
+    for (u32 page = first; page <= last; page++) {
+        if (test_page(page))
+            return true;
+    }
+
+    return false;
+}
+
 typedef struct watchpoint_event {
     u32 addr;
     u32 size;
@@ -242,9 +294,17 @@ private:
     decode_cache m_decode_cache;
     decode_function m_decode_table[NUM_OPCODES];
 
+    u32 m_latency[NUM_OPCODES];
+    u32 m_branch_penalty;
+    u32 m_load_use_penalty;
+    u32* m_load_dest;
+
     bool m_stop_requested;
     bool m_break_requested;
 
+    bool m_roi_enabled;
+    bool m_roi_hit;
+
     u64 m_instructions;
     u64 m_cycles;
     u64 m_compiles;
@@ -253,6 +313,14 @@ private:
 
     clock_t m_clock;
 
+    bool m_realtime;
+    u64 m_rt_cycles; // cycle count at m_rt_start
+    u64 m_rt_start;  // host time in nanoseconds
+    u64 m_rt_checks;
+    u64 m_rt_behind;
+    u64 m_rt_lag_max;
+    u64 m_rt_lag_sum;
+
     u32 m_jump_target;
     u64 m_jump_insn;
 
@@ -266,9 +334,6 @@ private:
     u32 m_version2;
     u32 m_avr;
 
-    u32 m_dccfgr;
-    u32 m_iccfgr;
-
     u32 m_unit;
     u32 m_cpucfg;
     u32 m_fpcfg;
@@ -294,6 +359,7 @@ private:
     bool m_pic_level;
     u32 m_pic_mr;
     u32 m_pic_sr;
+    std::atomic<u64> m_pic_mailbox; // lower half sets, upper half clears
 
     u32 m_core_id;
     u32 m_num_cores;
@@ -302,27 +368,52 @@ private:
     u64 m_num_excl_write;
     u64 m_num_excl_failed;
 
-    u64 m_tick_update;
+    event_queue m_events;
+    u32 m_tick_event;
+    u32 m_poll_event;
+    u32 m_replay_event;
 
     tick m_tick;
     mmu m_dmmu;
     mmu m_immu;
+    cache m_dcache;
+    cache m_icache;
     env* m_env;
 
     request m_ireq;
     request m_dreq;
 
-    vector<u32> m_breakpoints;
+    unordered_set<u32> m_breakpoints;
+    unordered_set<u32> m_breakpoint_offsets; // page offsets of breakpoints
+    bool m_breakpoint_hit;
+    u32 m_breakpoint_prev_pc;
 
     vector<watchpoint> m_watchpoints_r;
     vector<watchpoint> m_watchpoints_w;
 
+    watchpoint_filter m_watchfilter_r;
+    watchpoint_filter m_watchfilter_w;
+
     watchpoint_event m_wp_event;
 
+    bool m_wcb_enabled;
+    u32 m_wcb_addr;
+    u32 m_wcb_mask;
+    unsigned char m_wcb_data[OR1KISS_WCB_SIZE];
+
     bool m_trace_enabled;
     u32 m_trace_addr;
     ostream* m_user_trace_stream;
     ofstream* m_file_trace_stream;
+    ostream* m_console;
+
+    memtrace_writer* m_memtrace;
+
+    replay_writer* m_recorder;
+    replay_reader* m_replayer;
+    replay_record m_replay; // next record to be replayed
+
+    string m_snapshot; // state saved by capture_snapshot
 
     int m_fp_round_mode;
 
@@ -336,26 +427,50 @@ private:
 
     void schedule_jump(u32 target, u32 delay);
 
+    void stall(u32 cycles);
+    void check_load_use(const instruction* insn);
+
     instruction* fetch();
 
     step_result advance(unsigned int cycles);
 
     void doze();
+
+    u64 realtime_deadline(u64 cycle);
+    void pace();
+    u64 pace_sleep(u64 until);
     bool transact(request& req);
+    void record_access(const request& req);
+
+    void record_input(replay_kind kind, u64 value, u64 cycles = 0,
+                      response resp = RESP_SUCCESS);
+    replay_record replay_take(replay_kind kind);
+    void replay_advance();
+    u64 replay_input(replay_kind kind, u64 value);
+    response replay_transact(request& req);
+
+    bool is_postable(const request& req) const;
+    bool post_write(const request& req);
+    bool drain_write_buffer(u32& addr);
+    bool flush_write_buffer();
     void exception(unsigned int type, u32 addr = 0);
     void do_trace(const instruction*);
 
     void interrupt_level(int id, bool set);
     void interrupt_edge(int id, bool set);
 
-    void update_timer();
+    u32 get_pic_sr() const;
+    void apply_interrupts(u64 post);
+    void deliver_interrupts();
+    void check_interrupts();
+
+    void schedule_tick();
 
     void vwarn(const char* format, va_list args) const;
 
     void warn(const char* format, ...) const;
     bool warn(bool condition, const char* format, ...) const;
 
-    u64 next_breakpoint() const;
     bool breakpoint_hit() const;
     bool watchpoint_hit() const;
 
@@ -501,6 +616,9 @@ private:
 
     void decode_na(instruction*);
 
+    // Debugging
+    void execute_breakpoint(instruction*);
+
     // ORBIS32
     void execute_orbis32_mfspr(instruction*);
     void execute_orbis32_mtspr(instruction*);
@@ -621,6 +739,8 @@ public:
 
     bool is_dmmu_active() const { return m_status & SR_DME; }
     bool is_immu_active() const { return m_status & SR_IME; }
+    bool is_dcache_active() const;
+    bool is_icache_active() const;
     bool is_supervisor() const { return m_status & SR_SM; }
     bool is_ext_irq_enabled() const { return m_status & SR_IEE; }
     bool is_tick_irq_enabled() const { return m_status & SR_TEE; }
@@ -633,11 +753,29 @@ public:
     void allow_sleep(bool b = true) { m_allow_sleep = b; }
     bool is_sleeping() const;
 
+    // Lets a sleeping core pass up to n cycles without simulating it, e.g.
+    // to park it while other cores run. Stops where doze() would wake up
+    // and returns the number of cycles that passed, zero if it is awake.
+    u64 idle(u64 cycles);
+
+    // NOP_ROI is a plain nop unless enabled, in which case step returns
+    // STEP_ROI right after it so the caller can take over from there.
+    bool is_roi_enabled() const { return m_roi_enabled; }
+    void enable_roi(bool set = true) { m_roi_enabled = set; }
+
     clock_t get_clock() const { return m_clock; }
     void set_clock(u32 clk) { m_clock = clk; }
 
+    bool is_realtime() const { return m_realtime; }
+    void set_realtime(bool set = true);
+
+    u64 get_realtime_checks() const { return m_rt_checks; }
+    u64 get_realtime_behind() const { return m_rt_behind; }
+    u64 get_realtime_max_lag() const { return m_rt_lag_max; }
+    u64 get_realtime_avg_lag() const;
+
     u32 get_core_id() const { return m_core_id; }
-    void set_core_id(u32 id) { m_core_id = id; }
+    void set_core_id(u32 id);
     u32 get_numcores() const { return m_num_cores; }
     void set_numcores(u32 n) { m_num_cores = n; }
 
@@ -648,6 +786,18 @@ public:
 
     bool is_decode_cache_off() const;
 
+    u32 get_latency(opcode op) const { return m_latency[op]; }
+    void set_latency(opcode op, u32 cycles);
+
+    u32 get_branch_penalty() const { return m_branch_penalty; }
+    void set_branch_penalty(u32 cycles);
+
+    u32 get_load_use_penalty() const { return m_load_use_penalty; }
+    void set_load_use_penalty(u32 cycles) { m_load_use_penalty = cycles; }
+
+    bool is_write_combining() const { return m_wcb_enabled; }
+    void set_write_combining(bool set = true);
+
     u64 get_num_cycles() const { return m_cycles; }
     u64 get_num_instructions() const { return m_instructions; }
     u64 get_num_compiles() const { return m_compiles; }
@@ -670,6 +820,9 @@ public:
     env* get_env() { return m_env; }
     mmu* get_dmmu() { return &m_dmmu; }
     mmu* get_immu() { return &m_immu; }
+    cache* get_dcache() { return &m_dcache; }
+    cache* get_icache() { return &m_icache; }
+    event_queue* get_events() { return &m_events; }
 
     bool is_pic_level() const { return m_pic_level; }
     bool is_pic_edge() const { return !m_pic_level; }
@@ -679,6 +832,11 @@ public:
 
     void interrupt(int, bool);
 
+    // Unlike interrupt, this may be called from any host thread while the
+    // core is simulating. Posted interrupts take effect within at most
+    // OR1KISS_PIC_POLL cycles and wake up a dozing core.
+    void post_interrupt(int, bool);
+
     u32 get_spr(u32, bool = false) const;
     void set_spr(u32, u32, bool = false);
 
@@ -697,12 +855,12 @@ public:
     void insert_watchpoint_w(u32 addr, u32 size);
     void remove_watchpoint_w(u32 addr, u32 size);
 
-    const vector<u32>& get_breakpoints() const;
+    const unordered_set<u32>& get_breakpoints() const;
 
     const vector<watchpoint>& get_watchpoints_r() const;
     const vector<watchpoint>& get_watchpoints_w() const;
 
-    vector<u32> get_breakpoints();
+    unordered_set<u32> get_breakpoints();
 
     vector<watchpoint> get_watchpoints_r();
     vector<watchpoint> get_watchpoints_w();
@@ -711,18 +869,68 @@ public:
 
     void trace(ostream& = std::cout);
     void trace(const string&);
+
+    void trace_memory(const string& filename, bool compress = true);
+
+    // Inputs from outside the simulation, i.e. NOP_RANDOM, NOP_HOST_TIME,
+    // interrupts and data accesses outside DMI, can be recorded and later
+    // be replayed at exactly the same instructions. Only one of both can
+    // be active at a time. Once the log is used up, replay goes live again.
+    bool is_recording() const { return m_recorder != NULL; }
+    bool is_replaying() const { return m_replayer != NULL; }
+
+    void record_inputs(const string& filename);
+    void replay_inputs(const string& filename);
+
+    ostream& get_console() const { return *m_console; }
+    void set_console(ostream& os = std::cout) { m_console = &os; }
+
+    void invalidate_decode_cache();
+    void invalidate_decode_cache(u32 addr, u32 size);
+
+    void save_state(ostream& os) const;
+    void restore_state(istream& is, bool invalidate = true);
+
+    // In-process snapshots for fast resets. Restoring only drops decoded
+    // instructions from the given physical pages, which the environment
+    // reports as written since the capture (see memory::restore_snapshot).
+    bool has_snapshot() const { return !m_snapshot.empty(); }
+    void capture_snapshot();
+    void restore_snapshot(const vector<u64>& pages, u64 page_size);
 };
 
+inline bool or1k::breakpoint_hit() const {
+    return m_breakpoint_hit;
+}
+
 inline bool or1k::watchpoint_hit() const {
     return m_wp_event.hit;
 }
 
 inline bool or1k::is_interrupt_pending() const {
-    return m_pic_sr & m_pic_mr;
+    return get_pic_sr() & m_pic_mr;
 }
 
 inline bool or1k::is_interrupt_pending(int no) const {
-    return (m_pic_sr & m_pic_mr) & (1 << no);
+    return (get_pic_sr() & m_pic_mr) & (1 << no);
+}
+
+inline u32 or1k::get_pic_sr() const {
+    // Recording only lets posted interrupts in once they are delivered
+    u64 post = m_recorder ? 0 : m_pic_mailbox.load(std::memory_order_acquire);
+    u32 clr  = m_pic_level ? (u32)(post >> 32) : 0;
+    return (m_pic_sr | (u32)post) & ~clr;
+}
+
+inline void or1k::check_interrupts() {
+    if (unlikely(m_tick.irq_pending()))
+        exception(EX_TICK_TIMER);
+
+    if (unlikely(m_pic_mailbox.load(std::memory_order_relaxed) != 0))
+        deliver_interrupts();
+
+    if (unlikely(m_pic_sr & m_pic_mr))
+        exception(EX_EXTERNAL);
 }
 
 inline bool or1k::is_exception_pending() const {
@@ -733,6 +941,12 @@ inline bool or1k::is_sleeping() const {
     return is_sleep_allowed() && !is_exception_pending() && (m_pmr & PMR_DME);
 }
 
+inline void or1k::set_core_id(u32 id) {
+    m_core_id = id;
+    m_ireq.set_core_id(id);
+    m_dreq.set_core_id(id);
+}
+
 inline u64 or1k::get_num_swa_failed() const {
     return m_num_excl_failed;
 }
@@ -741,10 +955,47 @@ inline void or1k::reset_exclusive() {
     m_num_excl_read = m_num_excl_write = m_num_excl_failed = 0;
 }
 
+inline bool or1k::is_dcache_active() const {
+    return (m_status & SR_DCE) && m_dcache.is_enabled();
+}
+
+inline bool or1k::is_icache_active() const {
+    return (m_status & SR_ICE) && m_icache.is_enabled();
+}
+
+inline bool or1k::is_postable(const request& req) const {
+    return req.is_write() && !req.is_exclusive() && is_dmmu_active() &&
+           req.is_weakly_ordered() && !req.is_cache_inhibit() &&
+           m_env->get_data_ptr(req.addr) == NULL;
+}
+
+inline bool or1k::flush_write_buffer() {
+    u32 addr = 0;
+    if (likely(drain_write_buffer(addr)))
+        return true;
+
+    exception(EX_DATA_BUS_ERROR, addr);
+    return false;
+}
+
+inline void or1k::set_write_combining(bool set) {
+    if (!set)
+        flush_write_buffer();
+    m_wcb_enabled = set;
+}
+
 inline bool or1k::is_decode_cache_off() const {
     return m_decode_cache.is_enabled();
 }
 
+inline void or1k::invalidate_decode_cache() {
+    m_decode_cache.invalidate_all();
+}
+
+inline void or1k::invalidate_decode_cache(u32 addr, u32 size) {
+    m_decode_cache.invalidate_block(addr, size);
+}
+
 inline void or1k::setup_fp_round_mode() {
     // Setup rounding mode
     m_fp_round_mode   = fegetround();
@@ -881,6 +1132,22 @@ inline void or1k::schedule_jump(u32 target, u32 delay) {
         exception(EX_INSN_ALIGNMENT, m_jump_target);
 }
 
+inline u64 or1k::get_realtime_avg_lag() const {
+    return m_rt_behind ? m_rt_lag_sum / m_rt_behind : 0;
+}
+
+inline void or1k::stall(u32 cycles) {
+    m_cycles += cycles;
+    m_limit += cycles;
+}
+
+inline void or1k::check_load_use(const instruction* insn) {
+    // Stall if the loaded value is needed right away by the next insn
+    if (insn && (insn->src1 == m_load_dest || insn->src2 == m_load_dest))
+        stall(m_load_use_penalty);
+    m_load_dest = NULL;
+}
+
 inline float or1k::get_decode_cache_hit_rate() const {
     if (m_instructions == 0)
         return 0.0f;
@@ -896,11 +1163,11 @@ inline void or1k::trigger_tlb_miss(u32 addr) {
     exception(EX_DATA_TLB_MISS, addr);
 }
 
-inline const std::vector<u32>& or1k::get_breakpoints() const {
+inline const unordered_set<u32>& or1k::get_breakpoints() const {
     return m_breakpoints;
 }
 
-inline std::vector<u32> or1k::get_breakpoints() {
+inline unordered_set<u32> or1k::get_breakpoints() {
     return m_breakpoints;
 }
 
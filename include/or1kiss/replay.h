@@ -0,0 +1,106 @@
+/******************************************************************************
+ *                                                                            *
+ * Copyright 2018 Jan Henrik Weinstock                                        *
+ *                                                                            *
+ * Licensed under the Apache License, Version 2.0 (the "License");            *
+ * you may not use this file except in compliance with the License.           *
+ * You may obtain a copy of the License at                                    *
+ *                                                                            *
+ *     http://www.apache.org/licenses/LICENSE-2.0                             *
+ *                                                                            *
+ * Unless required by applicable law or agreed to in writing, software        *
+ * distributed under the License is distributed on an "AS IS" BASIS,          *
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.   *
+ * See the License for the specific language governing permissions and        *
+ * limitations under the License.                                             *
+ *                                                                            *
+ ******************************************************************************/
+
+#ifndef OR1KISS_REPLAY_H
+#define OR1KISS_REPLAY_H
+
+#include "or1kiss/includes.h"
+#include "or1kiss/types.h"
+#include "or1kiss/utils.h"
+#include "or1kiss/exception.h"
+#include "or1kiss/logfile.h"
+
+#define OR1KISS_REPLAY_MAGIC   "OR1KRPLY"
+#define OR1KISS_REPLAY_VERSION (1)
+#define OR1KISS_REPLAY_BUFFER  (64 * 1024)
+
+namespace or1kiss {
+
+// A replay log starts with a replay_header, followed by the inputs a core
+// received from outside the simulation in the order it consumed them. The
+// instruction and cycle counts are delta encoded against the predecessor:
+//   u8     kind in bits 0..3, bus response in bits 4..5 (REPLAY_BUS only)
+//   varint instructions executed since the previous record
+//   varint cycles elapsed since the previous record
+//   varint value
+//   varint access cycles (REPLAY_BUS only)
+enum replay_kind {
+    REPLAY_RANDOM    = 0, // result of l.nop NOP_RANDOM
+    REPLAY_HOST_TIME = 1, // result of l.nop NOP_HOST_TIME
+    REPLAY_IRQ       = 2, // interrupt mailbox contents upon delivery
+    REPLAY_BUS       = 3, // data access outside DMI, value holds read data
+};
+
+enum replay_flags {
+    REPLAY_KIND = 0xf << 0, // replay_kind
+    REPLAY_RESP = 0x3 << 4, // response, two's complement
+};
+
+typedef logfile_header replay_header;
+
+struct replay_record {
+    u64 insn;
+    u64 cycle;
+    u64 value;
+    u64 cycles;
+    int resp;
+    replay_kind kind;
+};
+
+class replay_writer
+{
+private:
+    FILE* m_file;
+    u64 m_insn;
+    u64 m_cycle;
+    u64 m_records;
+    vector<u8> m_buffer;
+
+public:
+    u64 get_num_records() const { return m_records; }
+
+    replay_writer(const string& filename);
+    virtual ~replay_writer();
+
+    replay_writer()                     = delete;
+    replay_writer(const replay_writer&) = delete;
+
+    void record(const replay_record& rec);
+    void flush();
+};
+
+class replay_reader
+{
+private:
+    FILE* m_file;
+    u64 m_insn;
+    u64 m_cycle;
+
+public:
+    replay_reader(const string& filename);
+    virtual ~replay_reader();
+
+    replay_reader()                     = delete;
+    replay_reader(const replay_reader&) = delete;
+
+    bool next(replay_record& rec);
+};
+
+} // namespace or1kiss
+
+#endif
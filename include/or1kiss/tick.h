@@ -21,6 +21,7 @@
 
 #include "or1kiss/includes.h"
 #include "or1kiss/types.h"
+#include "or1kiss/utils.h"
 #include "or1kiss/exception.h"
 #include "or1kiss/bitops.h"
 
@@ -40,40 +41,43 @@ class tick
 private:
     bool m_done;
     u32 m_ttmr;
-    u32 m_ttcr;
+    u32 m_ttcr; // counter value at cycle m_base
+    u64 m_base;
+
+    u32 counter(u64 now) const {
+        return running() ? m_ttcr + (u32)(now - m_base) : m_ttcr;
+    }
 
 public:
     u32 get_ttmr() const { return m_ttmr; }
-    u32 get_ttcr() const { return m_ttcr; }
+    u32 get_ttcr(u64 now) const;
 
-    void set_ttmr(u32 v) {
-        m_ttmr = v;
-        update(0);
-    }
-
-    void set_ttcr(u32 v) {
-        m_ttcr = v;
-        m_done = false;
-        update(0);
-    }
+    void set_ttmr(u32 v, u64 now);
+    void set_ttcr(u32 v, u64 now);
 
     bool enabled() const { return m_ttmr >> 30; }
+    bool running() const { return enabled() && !m_done; }
     bool irq_enabled() const { return m_ttmr & TM_IE; }
     bool irq_pending() const { return m_ttmr & TM_IP; }
 
     u32 limit() const { return bits32(m_ttmr, 27, 0); }
-    u32 current() const { return bits32(m_ttcr, 27, 0); }
-    u64 next_tick() const {
-        if (current() < limit())
-            return limit() - current();
+
+    u64 next_tick(u64 now) const { return expiry() - min(now, expiry()); }
+    u64 expiry() const {
+        u64 cur = bits32(m_ttcr, 27, 0);
+        if (cur < limit())
+            return m_base + limit() - cur;
         else
-            return 0x0fffffffull - current() + limit() + 1ull;
+            return m_base + 0x0fffffffull - cur + limit() + 1ull;
     }
 
     tick();
     virtual ~tick();
 
-    void update(u64 delta = 1);
+    void update(u64 now);
+
+    void save_state(ostream& os) const;
+    void restore_state(istream& is);
 };
 
 } // namespace or1kiss
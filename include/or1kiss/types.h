@@ -42,6 +42,7 @@ using std::isinf;
 using std::pair;
 using std::string;
 using std::vector;
+using std::unordered_set;
 
 using std::ostream;
 using std::istream;
@@ -108,6 +108,19 @@ inline void stl_remove_erase_if(V& v, PRED p) {
     v.erase(std::remove_if(v.begin(), v.end(), p), v.end());
 }
 
+// serialize writes the raw representation of a trivially copyable value
+// to the given output stream, deserialize reads it back. Both are used for
+// checkpointing and do not care about host endianess.
+template <typename T>
+inline void serialize(ostream& os, const T& val) {
+    os.write(reinterpret_cast<const char*>(&val), sizeof(T));
+}
+
+template <typename T>
+inline void deserialize(istream& is, T& val) {
+    is.read(reinterpret_cast<char*>(&val), sizeof(T));
+}
+
 // stl_make_str builds a std::string object from a printf like
 // variable length argument list.
 inline std::string stl_make_str(const char* fmt, ...) {
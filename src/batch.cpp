@@ -0,0 +1,238 @@
+/******************************************************************************
+ *                                                                            *
+ * Copyright 2018 Jan Henrik Weinstock                                        *
+ *                                                                            *
+ * Licensed under the Apache License, Version 2.0 (the "License");            *
+ * you may not use this file except in compliance with the License.           *
+ * You may obtain a copy of the License at                                    *
+ *                                                                            *
+ *     http://www.apache.org/licenses/LICENSE-2.0                             *
+ *                                                                            *
+ * Unless required by applicable law or agreed to in writing, software        *
+ * distributed under the License is distributed on an "AS IS" BASIS,          *
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.   *
+ * See the License for the specific language governing permissions and        *
+ * limitations under the License.                                             *
+ *                                                                            *
+ ******************************************************************************/
+
+#include <fstream>
+#include <sstream>
+#include <sys/time.h>
+
+#include "batch.h"
+#include "board.h"
+#include "pool.h"
+#include "uart.h"
+#include "timer.h"
+
+// Jobs are usually small test programs, so every worker gets a smaller
+// decode cache than a regular simulation to keep memory usage in check.
+#define BATCH_DECODE_CACHE (or1kiss::DECODE_CACHE_SIZE_1M)
+#define BATCH_QUANTUM      (10000)
+
+static bool is_elf(const std::string& filename) {
+    char magic[4] = { 0 };
+    std::ifstream is(filename.c_str(), std::ios::binary);
+    is.read(magic, sizeof(magic));
+    return is && memcmp(magic, "\177ELF", sizeof(magic)) == 0;
+}
+
+static std::string json_escape(const std::string& s) {
+    std::string res;
+    for (unsigned char c : s) {
+        switch (c) {
+        case '"':
+            res += "\\\"";
+            break;
+        case '\\':
+            res += "\\\\";
+            break;
+        case '\n':
+            res += "\\n";
+            break;
+        case '\r':
+            res += "\\r";
+            break;
+        case '\t':
+            res += "\\t";
+            break;
+        default:
+            if (c < 0x20) {
+                char buf[8];
+                snprintf(buf, sizeof(buf), "\\u%04x", c);
+                res += buf;
+            } else {
+                res += c;
+            }
+        }
+    }
+
+    return res;
+}
+
+batch::slot::slot(uint64_t memsize, or1kiss::decode_cache_size dcsz):
+    mem(memsize), core(&mem, dcsz), pages() {
+    /* Nothing to do */
+}
+
+batch::batch(const char* jobfile, uint64_t budget):
+    m_jobs(),
+    m_elfs(),
+    m_slots(),
+    m_memsize(0x08000000),
+    m_swapped(false),
+    m_dcsz(BATCH_DECODE_CACHE),
+    m_quantum(BATCH_QUANTUM),
+    m_setup(),
+    m_mutex(),
+    m_failed(0) {
+    std::ifstream is(jobfile);
+    if (!is)
+        OR1KISS_ERROR("cannot open job file '%s'", jobfile);
+
+    std::string line;
+    for (unsigned int lineno = 1; std::getline(is, line); lineno++) {
+        std::istringstream ss(line);
+        job j = { "", budget, nullptr };
+        if (!(ss >> j.file) || j.file[0] == '#')
+            continue;
+
+        if (!(ss >> j.budget) && !ss.eof())
+            OR1KISS_ERROR("%s:%u: invalid budget", jobfile, lineno);
+
+        // Parse each elf only once, loading it later on is thread-safe
+        if (is_elf(j.file)) {
+            auto& elf = m_elfs[j.file];
+            if (!elf)
+                elf = std::make_shared<or1kiss::elf>(j.file);
+            j.elf = elf;
+        }
+
+        m_jobs.push_back(j);
+    }
+}
+
+batch::~batch() {
+    /* Nothing to do */
+}
+
+void batch::set_memory(uint64_t size, bool swapped) {
+    m_memsize = size;
+    m_swapped = swapped;
+}
+
+void batch::set_decode_cache_size(or1kiss::decode_cache_size dcsz) {
+    m_dcsz = dcsz;
+}
+
+void batch::set_quantum(unsigned int quantum) {
+    if (quantum == 0)
+        OR1KISS_ERROR("invalid quantum");
+    m_quantum = quantum;
+}
+
+batch::slot& batch::get_slot(unsigned int worker) {
+    // Slots are created on first use by the worker owning them, so that
+    // their memory gets allocated on the node that worker runs on.
+    std::unique_ptr<slot>& s = m_slots[worker];
+    if (!s) {
+        s.reset(new slot(m_memsize, m_dcsz));
+        s->mem.set_dmi_swapped(m_swapped);
+        if (m_setup)
+            m_setup(s->core);
+
+        s->core.capture_snapshot();
+        s->mem.capture_snapshot();
+    }
+
+    return *s;
+}
+
+void batch::run_job(unsigned int worker, size_t idx) {
+    const job& j = m_jobs[idx];
+    std::ostringstream out, res;
+    res << "{\"job\":" << idx << ",\"file\":\"" << json_escape(j.file)
+        << "\"";
+
+    timeval t1, t2;
+    gettimeofday(&t1, NULL);
+
+    slot& s = get_slot(worker);
+    or1kiss::or1k& core = s.core;
+    bool failed         = true;
+
+    uart uart0("uart0", UART_BASE);
+    uart0.redirect(out);
+    uart0.connect(&core, UART_IRQ);
+
+    timer timer0("timer0", TIMER_BASE);
+    timer0.connect(&core, TIMER_IRQ);
+
+    try {
+        // Start over from a pristine core and a clean memory
+        s.mem.restore_snapshot(s.pages);
+        core.restore_snapshot(s.pages, s.mem.get_page_size());
+        core.reset_compiles();
+        core.set_console(out);
+
+        if (j.elf)
+            j.elf->load(&s.mem);
+        else if (!s.mem.load(j.file.c_str()))
+            OR1KISS_ERROR("cannot load '%s'", j.file.c_str());
+
+        s.mem.attach(&uart0);
+        s.mem.attach(&timer0);
+
+        uint64_t budget        = j.budget;
+        or1kiss::step_result r = or1kiss::STEP_OK;
+        while ((r == or1kiss::STEP_OK) && (budget > 0)) {
+            unsigned int cycles = std::min<uint64_t>(m_quantum, budget);
+            r = core.step(cycles);
+            budget -= std::min<uint64_t>(cycles, budget);
+            s.mem.update_devices();
+        }
+
+        if (r == or1kiss::STEP_EXIT) {
+            failed = core.gpr[3] != 0;
+            res << ",\"status\":\"exit\",\"code\":" << core.gpr[3];
+        } else {
+            res << ",\"status\":\"timeout\"";
+        }
+    } catch (std::exception& ex) {
+        res << ",\"status\":\"error\",\"error\":\""
+            << json_escape(ex.what()) << "\"";
+    }
+
+    s.mem.detach(&uart0);
+    s.mem.detach(&timer0);
+    core.set_console();
+
+    gettimeofday(&t2, NULL);
+    double t = (t2.tv_sec - t1.tv_sec) + (t2.tv_usec - t1.tv_usec) * 1e-6;
+
+    res << ",\"cycles\":" << core.get_num_cycles()
+        << ",\"instructions\":" << core.get_num_instructions()
+        << ",\"seconds\":" << t << ",\"output\":\"" << json_escape(out.str())
+        << "\"}";
+
+    std::lock_guard<std::mutex> guard(m_mutex);
+    if (failed)
+        m_failed++;
+
+    fprintf(stdout, "%s\n", res.str().c_str());
+    fflush(stdout);
+}
+
+unsigned int batch::run(unsigned int nthreads) {
+    m_failed = 0;
+    m_slots.clear();
+    m_slots.resize(nthreads);
+
+    pool workers(nthreads);
+    for (size_t i = 0; i < m_jobs.size(); i++)
+        workers.submit([this, i](unsigned int worker) { run_job(worker, i); });
+    workers.wait();
+
+    return m_failed;
+}
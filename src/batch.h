@@ -0,0 +1,100 @@
+/******************************************************************************
+ *                                                                            *
+ * Copyright 2018 Jan Henrik Weinstock                                        *
+ *                                                                            *
+ * Licensed under the Apache License, Version 2.0 (the "License");            *
+ * you may not use this file except in compliance with the License.           *
+ * You may obtain a copy of the License at                                    *
+ *                                                                            *
+ *     http://www.apache.org/licenses/LICENSE-2.0                             *
+ *                                                                            *
+ * Unless required by applicable law or agreed to in writing, software        *
+ * distributed under the License is distributed on an "AS IS" BASIS,          *
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.   *
+ * See the License for the specific language governing permissions and        *
+ * limitations under the License.                                             *
+ *                                                                            *
+ ******************************************************************************/
+
+#ifndef BATCH_H
+#define BATCH_H
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <functional>
+#include <unordered_map>
+
+#include "or1kiss.h"
+#include "memory.h"
+
+// Runs many independent programs inside one process, spread across the
+// threads of a work-stealing pool. The job file lists one program per line,
+// optionally followed by its own cycle budget:
+//
+//   # comment
+//   tests/hello.elf
+//   tests/loop.bin 1000000
+//
+// Files starting with an ELF header are parsed once up front and shared by
+// all jobs using them, anything else is loaded as raw binary. Every worker
+// keeps its memory and core around and resets them to an in-process snapshot
+// between jobs, which only copies back what the previous job wrote. Results
+// are streamed to stdout as one JSON object per line, in order of
+// completion.
+class batch
+{
+public:
+    typedef std::function<void(or1kiss::or1k&)> setup_func;
+
+private:
+    struct job {
+        std::string file;
+        uint64_t budget;
+        std::shared_ptr<or1kiss::elf> elf;
+    };
+
+    struct slot {
+        memory mem;
+        or1kiss::or1k core;
+        std::vector<uint64_t> pages; // written by the previous job
+
+        slot(uint64_t memsize, or1kiss::decode_cache_size dcsz);
+    };
+
+    std::vector<job> m_jobs;
+    std::unordered_map<std::string, std::shared_ptr<or1kiss::elf>> m_elfs;
+    std::vector<std::unique_ptr<slot>> m_slots;
+
+    uint64_t m_memsize;
+    bool m_swapped;
+    or1kiss::decode_cache_size m_dcsz;
+    unsigned int m_quantum;
+    setup_func m_setup;
+
+    std::mutex m_mutex;
+    unsigned int m_failed;
+
+    slot& get_slot(unsigned int worker);
+    void run_job(unsigned int worker, size_t idx);
+
+    // Disabled
+    batch();
+    batch(const batch&);
+
+public:
+    size_t get_num_jobs() const { return m_jobs.size(); }
+
+    batch(const char* jobfile, uint64_t budget);
+    virtual ~batch();
+
+    void set_memory(uint64_t size, bool swapped);
+    void set_decode_cache_size(or1kiss::decode_cache_size dcsz);
+    void set_quantum(unsigned int quantum);
+    void set_setup(const setup_func& setup) { m_setup = setup; }
+
+    unsigned int run(unsigned int nthreads);
+};
+
+#endif
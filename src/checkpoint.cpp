@@ -0,0 +1,275 @@
+/******************************************************************************
+ *                                                                            *
+ * Copyright 2018 Jan Henrik Weinstock                                        *
+ *                                                                            *
+ * Licensed under the Apache License, Version 2.0 (the "License");            *
+ * you may not use this file except in compliance with the License.           *
+ * You may obtain a copy of the License at                                    *
+ *                                                                            *
+ *     http://www.apache.org/licenses/LICENSE-2.0                             *
+ *                                                                            *
+ * Unless required by applicable law or agreed to in writing, software        *
+ * distributed under the License is distributed on an "AS IS" BASIS,          *
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.   *
+ * See the License for the specific language governing permissions and        *
+ * limitations under the License.                                             *
+ *                                                                            *
+ ******************************************************************************/
+
+#include <climits>
+#include <sys/stat.h>
+
+#include "checkpoint.h"
+
+#define CHECKPOINT_MAGIC   "OR1KCKPT"
+#define CHECKPOINT_VERSION (1)
+#define CHECKPOINT_ALIGN   (64ull << 10)
+
+struct checkpoint_header {
+    char magic[8];        // CHECKPOINT_MAGIC
+    uint32_t version;     // CHECKPOINT_VERSION
+    uint32_t page_size;   // size of each delta page
+    uint64_t mem_size;    // size of simulated memory
+    uint64_t state_size;  // bytes of processor state following the header
+    uint64_t parent_size; // bytes of parent filename following the state
+    uint64_t num_pages;   // number of page indices following the parent
+    uint64_t data_offset; // aligned file offset of memory contents
+};
+
+static uint64_t round_up(uint64_t size, uint64_t align) {
+    return (size + align - 1) & ~(align - 1);
+}
+
+static bool is_zero(const unsigned char* ptr, uint64_t size) {
+    return ptr[0] == 0 && !memcmp(ptr, ptr + 1, size - 1);
+}
+
+static void write_file(int fd, uint64_t offset, const void* src,
+                       uint64_t size) {
+    const char* ptr = (const char*)src;
+    while (size > 0) {
+        ssize_t n = pwrite(fd, ptr, size, offset);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            OR1KISS_ERROR("error writing checkpoint: %s", strerror(errno));
+
+        ptr    += n;
+        offset += n;
+        size   -= n;
+    }
+}
+
+static void read_file(int fd, uint64_t offset, void* dest, uint64_t size) {
+    char* ptr = (char*)dest;
+    while (size > 0) {
+        ssize_t n = pread(fd, ptr, size, offset);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            OR1KISS_ERROR("error reading checkpoint: %s",
+                          n ? strerror(errno) : "unexpected end of file");
+
+        ptr    += n;
+        offset += n;
+        size   -= n;
+    }
+}
+
+// Memory contents are stored in system byte order, so that checkpoints do
+// not depend on the memory layout used while saving them.
+static void write_memory(int fd, uint64_t offset, const memory& mem,
+                         uint64_t addr, uint64_t size) {
+    if (!mem.is_dmi_swapped()) {
+        write_file(fd, offset, mem.get_ptr() + addr, size);
+        return;
+    }
+
+    std::vector<unsigned char> buf(size);
+    or1kiss::memcpy_from_words(buf.data(), mem.get_ptr() + addr, size);
+    write_file(fd, offset, buf.data(), size);
+}
+
+static void read_memory(int fd, uint64_t offset, memory& mem, uint64_t addr,
+                        uint64_t size) {
+    if (!mem.is_dmi_swapped()) {
+        read_file(fd, offset, mem.get_ptr() + addr, size);
+        return;
+    }
+
+    std::vector<unsigned char> buf(size);
+    read_file(fd, offset, buf.data(), size);
+    or1kiss::memcpy_to_words(mem.get_ptr() + addr, buf.data(), size);
+}
+
+static std::string absolute_path(const std::string& filename) {
+    char path[PATH_MAX];
+    if (realpath(filename.c_str(), path) == NULL)
+        OR1KISS_ERROR("cannot resolve '%s': %s", filename.c_str(),
+                      strerror(errno));
+    return path;
+}
+
+checkpoint::checkpoint(or1kiss::or1k& cpu, memory& mem):
+    m_cpu(cpu),
+    m_mem(mem),
+    m_parent(),
+    m_chain() {
+    /* Nothing to do */
+}
+
+checkpoint::~checkpoint() {
+    /* Nothing to do */
+}
+
+std::string checkpoint::load(const std::string& filename) {
+    std::string path = absolute_path(filename);
+    if (std::count(m_chain.begin(), m_chain.end(), path))
+        OR1KISS_ERROR("checkpoint '%s' builds upon itself", path.c_str());
+    m_chain.push_back(path);
+
+    int fd = open(filename.c_str(), O_RDONLY, 0);
+    if (fd < 0)
+        OR1KISS_ERROR("cannot open checkpoint '%s': %s", filename.c_str(),
+                      strerror(errno));
+
+    checkpoint_header hdr;
+    read_file(fd, 0, &hdr, sizeof(hdr));
+
+    if (memcmp(hdr.magic, CHECKPOINT_MAGIC, sizeof(hdr.magic)))
+        OR1KISS_ERROR("'%s' is not a checkpoint", filename.c_str());
+    if (hdr.version != CHECKPOINT_VERSION)
+        OR1KISS_ERROR("unsupported checkpoint version %u", hdr.version);
+    if (hdr.mem_size != m_mem.get_size())
+        OR1KISS_ERROR("checkpoint needs %" PRIu64 " bytes memory",
+                      hdr.mem_size);
+
+    uint64_t offset = sizeof(hdr);
+    std::string state(hdr.state_size, '\0');
+    read_file(fd, offset, &state[0], hdr.state_size);
+    offset += hdr.state_size;
+
+    std::string parent(hdr.parent_size, '\0');
+    read_file(fd, offset, &parent[0], hdr.parent_size);
+    offset += hdr.parent_size;
+
+    if (parent.empty()) {
+        // Full image: map it, the kernel will only read what we touch
+        if (!m_mem.map_file(fd, hdr.data_offset, 0, hdr.mem_size))
+            OR1KISS_ERROR("error reading checkpoint '%s'", filename.c_str());
+    } else {
+        // Delta: bring back the parent memory, then apply our pages
+        load(parent);
+
+        std::vector<uint64_t> pages(hdr.num_pages);
+        read_file(fd, offset, pages.data(), pages.size() * sizeof(uint64_t));
+
+        for (uint64_t i = 0; i < pages.size(); i++) {
+            uint64_t addr = pages[i] * hdr.page_size;
+            if (addr >= hdr.mem_size)
+                OR1KISS_ERROR("invalid page in checkpoint '%s'",
+                              filename.c_str());
+
+            uint64_t size = std::min<uint64_t>(hdr.page_size,
+                                               hdr.mem_size - addr);
+            read_memory(fd, hdr.data_offset + i * hdr.page_size, m_mem,
+                        addr, size);
+        }
+    }
+
+    close(fd);
+    return state;
+}
+
+void checkpoint::check_target(const std::string& filename) const {
+    // Memory may still be mapped from the checkpoints we build upon, and a
+    // delta overwriting one of them would also end up as its own parent.
+    struct stat st;
+    if (m_chain.empty() || stat(filename.c_str(), &st) != 0)
+        return;
+
+    std::string path = absolute_path(filename);
+    if (std::count(m_chain.begin(), m_chain.end(), path))
+        OR1KISS_ERROR("cannot overwrite '%s', the new checkpoint builds "
+                      "upon it", filename.c_str());
+}
+
+void checkpoint::save(const std::string& filename) {
+    check_target(filename);
+
+    std::ostringstream os;
+    m_cpu.save_state(os);
+    std::string state = os.str();
+
+    // Without a parent, we need to write out all of memory. Otherwise, only
+    // the pages written since the last save or restore are stored.
+    std::vector<uint64_t> pages;
+    if (!m_parent.empty()) {
+        for (uint64_t page = 0; page < m_mem.get_num_pages(); page++) {
+            if (m_mem.is_dirty(page))
+                pages.push_back(page);
+        }
+    }
+
+    checkpoint_header hdr;
+    memcpy(hdr.magic, CHECKPOINT_MAGIC, sizeof(hdr.magic));
+    hdr.version     = CHECKPOINT_VERSION;
+    hdr.page_size   = m_mem.get_page_size();
+    hdr.mem_size    = m_mem.get_size();
+    hdr.state_size  = state.size();
+    hdr.parent_size = m_parent.size();
+    hdr.num_pages   = pages.size();
+    hdr.data_offset = round_up(sizeof(hdr) + state.size() + m_parent.size() +
+                                   pages.size() * sizeof(uint64_t),
+                               CHECKPOINT_ALIGN);
+
+    int fd = open(filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0)
+        OR1KISS_ERROR("cannot create checkpoint '%s': %s", filename.c_str(),
+                      strerror(errno));
+
+    uint64_t offset = 0;
+    write_file(fd, offset, &hdr, sizeof(hdr));
+    offset += sizeof(hdr);
+    write_file(fd, offset, state.data(), state.size());
+    offset += state.size();
+    write_file(fd, offset, m_parent.data(), m_parent.size());
+    offset += m_parent.size();
+    write_file(fd, offset, pages.data(), pages.size() * sizeof(uint64_t));
+
+    uint64_t size = hdr.page_size;
+    if (m_parent.empty()) {
+        // Zero pages are skipped and left as holes in a sparse file
+        for (uint64_t addr = 0; addr < hdr.mem_size; addr += size) {
+            uint64_t n = std::min(size, hdr.mem_size - addr);
+            if (!is_zero(m_mem.get_ptr() + addr, n))
+                write_memory(fd, hdr.data_offset + addr, m_mem, addr, n);
+        }
+
+        if (ftruncate(fd, hdr.data_offset + hdr.mem_size))
+            OR1KISS_ERROR("error writing checkpoint: %s", strerror(errno));
+    } else {
+        for (uint64_t i = 0; i < pages.size(); i++) {
+            write_memory(fd, hdr.data_offset + i * size, m_mem,
+                         pages[i] * size, size);
+        }
+    }
+
+    close(fd);
+
+    // Further checkpoints will build upon this one
+    m_parent = absolute_path(filename);
+    m_chain.insert(m_chain.begin(), m_parent);
+    m_mem.track_dirty();
+}
+
+void checkpoint::restore(const std::string& filename) {
+    m_mem.track_dirty(false);
+
+    m_chain.clear();
+    std::istringstream is(load(filename));
+    m_cpu.restore_state(is);
+
+    m_parent = absolute_path(filename);
+    m_mem.track_dirty();
+}
@@ -0,0 +1,59 @@
+/******************************************************************************
+ *                                                                            *
+ * Copyright 2018 Jan Henrik Weinstock                                        *
+ *                                                                            *
+ * Licensed under the Apache License, Version 2.0 (the "License");            *
+ * you may not use this file except in compliance with the License.           *
+ * You may obtain a copy of the License at                                    *
+ *                                                                            *
+ *     http://www.apache.org/licenses/LICENSE-2.0                             *
+ *                                                                            *
+ * Unless required by applicable law or agreed to in writing, software        *
+ * distributed under the License is distributed on an "AS IS" BASIS,          *
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.   *
+ * See the License for the specific language governing permissions and        *
+ * limitations under the License.                                             *
+ *                                                                            *
+ ******************************************************************************/
+
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include <string>
+
+#include "or1kiss.h"
+#include "memory.h"
+
+// A checkpoint file holds the processor state and the memory contents of a
+// simulation. The first checkpoint taken is a full memory image, which can
+// be mapped back into memory when restoring. Any further checkpoint taken
+// after a save or restore only holds the pages that have been written since,
+// plus a reference to the checkpoint it builds upon.
+class checkpoint
+{
+private:
+    or1kiss::or1k& m_cpu;
+    memory& m_mem;
+    std::string m_parent;
+    std::vector<std::string> m_chain; // m_parent and all its ancestors
+
+    std::string load(const std::string& filename);
+
+    // Disabled
+    checkpoint();
+    checkpoint(const checkpoint&);
+
+public:
+    checkpoint(or1kiss::or1k& cpu, memory& mem);
+    virtual ~checkpoint();
+
+    const std::string& get_parent() const { return m_parent; }
+
+    // Raises an error if filename is needed to restore the next checkpoint
+    void check_target(const std::string& filename) const;
+
+    void save(const std::string& filename);
+    void restore(const std::string& filename);
+};
+
+#endif
@@ -0,0 +1,102 @@
+/******************************************************************************
+ *                                                                            *
+ * Copyright 2018 Jan Henrik Weinstock                                        *
+ *                                                                            *
+ * Licensed under the Apache License, Version 2.0 (the "License");            *
+ * you may not use this file except in compliance with the License.           *
+ * You may obtain a copy of the License at                                    *
+ *                                                                            *
+ *     http://www.apache.org/licenses/LICENSE-2.0                             *
+ *                                                                            *
+ * Unless required by applicable law or agreed to in writing, software        *
+ * distributed under the License is distributed on an "AS IS" BASIS,          *
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.   *
+ * See the License for the specific language governing permissions and        *
+ * limitations under the License.                                             *
+ *                                                                            *
+ ******************************************************************************/
+
+#include <thread>
+#include <pthread.h>
+
+#include "cluster.h"
+#include "pool.h"
+
+cluster::cluster(memory& mem, const std::vector<or1kiss::or1k*>& cores,
+                 unsigned int quantum, bool pinned, unsigned int nthreads):
+    m_mem(mem),
+    m_cores(cores),
+    m_quantum(quantum),
+    m_nthreads(nthreads),
+    m_pinned(pinned),
+    m_pinned_workers(),
+    m_num_steps(0),
+    m_num_parked(0) {
+    if (cores.empty())
+        OR1KISS_ERROR("cluster needs at least one core");
+    if (quantum == 0)
+        OR1KISS_ERROR("invalid quantum");
+
+    // More threads than cores would only sit around idle
+    if ((m_nthreads == 0) || (m_nthreads > m_cores.size()))
+        m_nthreads = m_cores.size();
+}
+
+cluster::~cluster() {
+    /* Nothing to do */
+}
+
+void cluster::pin(unsigned int worker) {
+    // Only the worker itself touches its own entry
+    if (!m_pinned || m_pinned_workers[worker])
+        return;
+
+    unsigned int ncpus = std::max(1u, std::thread::hardware_concurrency());
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(worker % ncpus, &set);
+    if (pthread_setaffinity_np(pthread_self(), sizeof(set), &set))
+        fprintf(stderr, "(cluster) cannot pin worker %u\n", worker);
+    m_pinned_workers[worker] = 1;
+}
+
+void cluster::run(uint64_t budget) {
+    m_pinned_workers.assign(m_nthreads, 0);
+
+    pool workers(m_nthreads);
+    std::vector<or1kiss::step_result> results(m_cores.size());
+
+    bool stop = false;
+    while (!stop && (budget > 0)) {
+        unsigned int cycles = std::min<uint64_t>(m_quantum, budget);
+
+        // Cores keep their worker across quanta to stay warm in its caches
+        for (unsigned int id = 0; id < m_cores.size(); id++) {
+            or1kiss::or1k* core = m_cores[id];
+            results[id]         = or1kiss::STEP_OK;
+
+            uint64_t slept = core->idle(cycles);
+            if (slept == cycles) {
+                m_num_parked++;
+                continue;
+            }
+
+            unsigned int left = cycles - slept;
+            workers.submit(id % m_nthreads, [=, &results](unsigned int w) {
+                unsigned int n = left;
+                pin(w);
+                results[id] = core->step(n);
+            });
+
+            m_num_steps++;
+        }
+
+        // Workers are all done now, so devices can be updated safely
+        workers.wait();
+        m_mem.update_devices();
+        budget -= cycles;
+
+        for (or1kiss::step_result r : results)
+            stop |= (r != or1kiss::STEP_OK);
+    }
+}
@@ -0,0 +1,70 @@
+/******************************************************************************
+ *                                                                            *
+ * Copyright 2018 Jan Henrik Weinstock                                        *
+ *                                                                            *
+ * Licensed under the Apache License, Version 2.0 (the "License");            *
+ * you may not use this file except in compliance with the License.           *
+ * You may obtain a copy of the License at                                    *
+ *                                                                            *
+ *     http://www.apache.org/licenses/LICENSE-2.0                             *
+ *                                                                            *
+ * Unless required by applicable law or agreed to in writing, software        *
+ * distributed under the License is distributed on an "AS IS" BASIS,          *
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.   *
+ * See the License for the specific language governing permissions and        *
+ * limitations under the License.                                             *
+ *                                                                            *
+ ******************************************************************************/
+
+#ifndef CLUSTER_H
+#define CLUSTER_H
+
+#include <vector>
+
+#include "or1kiss.h"
+#include "memory.h"
+
+// Runs several cores that share one memory on a pool of host threads, which
+// may be smaller than the number of cores. Every quantum, each core that is
+// awake becomes a task for the worker it is assigned to; workers that run
+// out of cores steal from the others. Once all tasks finished, devices get
+// updated. Cores sleeping through the whole quantum are parked instead: they
+// only get their clock advanced until an interrupt or timer wakes them, so
+// idle cores cost next to nothing. Simulation ends once the budget is spent
+// or any core stops, e.g. because its software requested to exit.
+class cluster
+{
+private:
+    memory& m_mem;
+    std::vector<or1kiss::or1k*> m_cores;
+    unsigned int m_quantum;
+    unsigned int m_nthreads;
+    bool m_pinned;
+
+    std::vector<char> m_pinned_workers; // one byte each, set concurrently
+    uint64_t m_num_steps;
+    uint64_t m_num_parked;
+
+    void pin(unsigned int worker);
+
+    // Disabled
+    cluster();
+    cluster(const cluster&);
+
+public:
+    unsigned int get_quantum() const { return m_quantum; }
+    unsigned int get_num_threads() const { return m_nthreads; }
+    bool is_pinned() const { return m_pinned; }
+
+    uint64_t get_num_steps() const { return m_num_steps; }
+    uint64_t get_num_parked() const { return m_num_parked; }
+
+    cluster(memory& mem, const std::vector<or1kiss::or1k*>& cores,
+            unsigned int quantum, bool pinned = false,
+            unsigned int nthreads = 0);
+    virtual ~cluster();
+
+    void run(uint64_t budget = ~0ull);
+};
+
+#endif
@@ -0,0 +1,75 @@
+/******************************************************************************
+ *                                                                            *
+ * Copyright 2018 Jan Henrik Weinstock                                        *
+ *                                                                            *
+ * Licensed under the Apache License, Version 2.0 (the "License");            *
+ * you may not use this file except in compliance with the License.           *
+ * You may obtain a copy of the License at                                    *
+ *                                                                            *
+ *     http://www.apache.org/licenses/LICENSE-2.0                             *
+ *                                                                            *
+ * Unless required by applicable law or agreed to in writing, software        *
+ * distributed under the License is distributed on an "AS IS" BASIS,          *
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.   *
+ * See the License for the specific language governing permissions and        *
+ * limitations under the License.                                             *
+ *                                                                            *
+ ******************************************************************************/
+
+#include "device.h"
+
+device::device(const std::string& name, uint32_t base, uint32_t size,
+               uint64_t latency):
+    m_name(name),
+    m_base(base),
+    m_size(size),
+    m_latency(latency),
+    m_cpu(NULL),
+    m_irq(-1),
+    m_irq_level(-1) {
+    if (size == 0)
+        OR1KISS_ERROR("device %s has no size", name.c_str());
+    if ((uint64_t)base + size > (1ull << 32))
+        OR1KISS_ERROR("device %s exceeds address space", name.c_str());
+}
+
+device::~device() {
+    /* Nothing to do */
+}
+
+void device::connect(or1kiss::or1k* cpu, int irq) {
+    if ((irq < 0) || (irq >= 32))
+        OR1KISS_ERROR("invalid interrupt line %d for %s", irq, get_name());
+
+    m_cpu       = cpu;
+    m_irq       = irq;
+    m_irq_level = -1;
+}
+
+void device::interrupt(bool set) {
+    // Only post changes of the line level, so that idle devices do not
+    // keep waking up the core, e.g. on every update
+    if ((m_cpu == NULL) || (m_irq_level == (int)set))
+        return;
+
+    // Devices may be accessed by any core, so post instead of setting
+    // the interrupt line of the connected core directly
+    m_irq_level = set;
+    m_cpu->post_interrupt(m_irq, set);
+}
+
+uint64_t device::get_cycles() const {
+    return m_cpu ? m_cpu->get_num_cycles() : 0;
+}
+
+uint32_t device::load_value(const unsigned char* data, uint32_t size) {
+    uint32_t val = 0;
+    for (uint32_t i = 0; i < size && i < sizeof(val); i++)
+        val = (val << 8) | data[i];
+    return val;
+}
+
+void device::store_value(unsigned char* data, uint32_t size, uint32_t val) {
+    for (uint32_t i = size; i > 0; i--, val >>= 8)
+        data[i - 1] = val & 0xff;
+}
@@ -0,0 +1,85 @@
+/******************************************************************************
+ *                                                                            *
+ * Copyright 2018 Jan Henrik Weinstock                                        *
+ *                                                                            *
+ * Licensed under the Apache License, Version 2.0 (the "License");            *
+ * you may not use this file except in compliance with the License.           *
+ * You may obtain a copy of the License at                                    *
+ *                                                                            *
+ *     http://www.apache.org/licenses/LICENSE-2.0                             *
+ *                                                                            *
+ * Unless required by applicable law or agreed to in writing, software        *
+ * distributed under the License is distributed on an "AS IS" BASIS,          *
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.   *
+ * See the License for the specific language governing permissions and        *
+ * limitations under the License.                                             *
+ *                                                                            *
+ ******************************************************************************/
+
+#ifndef DEVICE_H
+#define DEVICE_H
+
+#include <string>
+
+#include "or1kiss.h"
+
+// Base class for memory mapped devices attached to the simulator memory
+// bus. Register accesses arrive with bus (big endian) data layout and with
+// addresses relative to the device base address. Devices may signal
+// interrupts to the processor via a line of its programmable interrupt
+// controller (PIC).
+class device
+{
+private:
+    std::string m_name;
+    uint32_t m_base;
+    uint32_t m_size;
+    uint64_t m_latency;
+
+    or1kiss::or1k* m_cpu;
+    int m_irq;
+    int m_irq_level; // last level posted, -1 if none yet
+
+    // Disabled
+    device();
+    device(const device&);
+
+protected:
+    void interrupt(bool set);
+    uint64_t get_cycles() const;
+
+    static uint32_t load_value(const unsigned char* data, uint32_t size);
+    static void store_value(unsigned char* data, uint32_t size, uint32_t val);
+
+public:
+    const char* get_name() const { return m_name.c_str(); }
+    uint32_t get_base() const { return m_base; }
+    uint32_t get_size() const { return m_size; }
+    uint32_t get_end() const { return m_base + m_size - 1; }
+    uint64_t get_latency() const { return m_latency; }
+    int get_irq() const { return m_irq; }
+
+    bool contains(uint32_t addr, uint32_t size) const;
+
+    device(const std::string& name, uint32_t base, uint32_t size,
+           uint64_t latency = 1);
+    virtual ~device();
+
+    void connect(or1kiss::or1k* cpu, int irq);
+
+    virtual or1kiss::response read(uint32_t offset, unsigned char* data,
+                                   uint32_t size) = 0;
+    virtual or1kiss::response write(uint32_t offset,
+                                    const unsigned char* data,
+                                    uint32_t size) = 0;
+
+    // Called regularly in between simulation quanta
+    virtual void update() {}
+};
+
+inline bool device::contains(uint32_t addr, uint32_t size) const {
+    return (addr >= m_base) &&
+           ((uint64_t)addr + size <= (uint64_t)m_base + m_size);
+}
+
+#endif
@@ -18,39 +18,203 @@
 
 #include <memory>
 #include <iostream>
+#include <sstream>
 #include <exception>
 #include <time.h>
+#include <getopt.h>
 #include <sys/time.h>
 #include <or1kiss.h>
 
+#include "board.h"
 #include "memory.h"
+#include "checkpoint.h"
+#include "uart.h"
+#include "timer.h"
+#include "cluster.h"
+#include "batch.h"
+#include "sweep.h"
+
+#define SIM_QUANTUM (10000)
+
+#define CACHE_WAYS    (1)
+#define CACHE_BLOCK   (16)
+#define CACHE_PENALTY (10)
+
+// Parses a cache description of the form size[:ways[:block[:penalty]]]
+static void configure_cache(or1kiss::cache* c, const char* spec) {
+    unsigned int size = 0, ways = CACHE_WAYS, block = CACHE_BLOCK;
+    unsigned int penalty = CACHE_PENALTY;
+    if (sscanf(spec, "%u:%u:%u:%u", &size, &ways, &block, &penalty) < 1)
+        OR1KISS_ERROR("invalid cache configuration '%s'", spec);
+    c->configure(size, ways, block, penalty);
+}
+
+// Parses a timing description: a comma separated list of name=cycles, with
+// name being an instruction mnemonic, a group (mul, div, fpu) or one of the
+// penalties for taken branches (branch) and load-use hazards (load-use).
+static void configure_timing(or1kiss::or1k& core, const char* spec) {
+    std::stringstream ss(spec);
+    std::string item;
+    while (std::getline(ss, item, ',')) {
+        size_t pos = item.find('=');
+        if (pos == std::string::npos)
+            OR1KISS_ERROR("invalid timing configuration '%s'", spec);
+
+        std::string name = item.substr(0, pos);
+        unsigned int cycles = atoi(item.c_str() + pos + 1);
+
+        std::vector<or1kiss::opcode> ops;
+        if (name == "branch") {
+            core.set_branch_penalty(cycles);
+        } else if (name == "load-use") {
+            core.set_load_use_penalty(cycles);
+        } else if (name == "mul") {
+            ops = { or1kiss::ORBIS32_MUL,   or1kiss::ORBIS32_MULU,
+                    or1kiss::ORBIS32_MULD,  or1kiss::ORBIS32_MULDU,
+                    or1kiss::ORBIS32_MULI,  or1kiss::ORBIS32_MAC,
+                    or1kiss::ORBIS32_MACU,  or1kiss::ORBIS32_MSB,
+                    or1kiss::ORBIS32_MSBU,  or1kiss::ORBIS32_MACI };
+        } else if (name == "div") {
+            ops = { or1kiss::ORBIS32_DIV, or1kiss::ORBIS32_DIVU };
+        } else if (name == "fpu") {
+            for (int op = or1kiss::ORFPX32_ADD; op < or1kiss::NUM_OPCODES;
+                 op++)
+                ops.push_back(static_cast<or1kiss::opcode>(op));
+        } else {
+            or1kiss::opcode op = or1kiss::find_opcode(name);
+            if (op == or1kiss::INVALID_OPCODE)
+                OR1KISS_ERROR("unknown instruction '%s'", name.c_str());
+            ops.push_back(op);
+        }
+
+        for (or1kiss::opcode op : ops)
+            core.set_latency(op, cycles);
+    }
+}
+
+// Parses a comma separated list of numbers, e.g. 1,2,0x10
+static std::vector<uint32_t> parse_params(const char* spec) {
+    std::vector<uint32_t> params;
+    std::stringstream ss(spec);
+    std::string item;
+    while (std::getline(ss, item, ',')) {
+        char* end = NULL;
+        params.push_back(strtoul(item.c_str(), &end, 0));
+        if (item.empty() || *end != '\0')
+            OR1KISS_ERROR("invalid parameter list '%s'", spec);
+    }
+
+    return params;
+}
+
+static void print_cache_stats(or1kiss::or1k& core) {
+    printf("# dcc hit rate : %f\n", core.get_decode_cache_hit_rate());
+    if (core.get_dcache()->is_enabled())
+        printf("# d$ hit rate  : %f\n", core.get_dcache()->get_hit_rate());
+    if (core.get_icache()->is_enabled())
+        printf("# i$ hit rate  : %f\n", core.get_icache()->get_hit_rate());
+}
+
+static void print_core_stats(or1kiss::or1k& core, double t) {
+    printf("# core %-8u: %" PRId64 " cycles, %" PRId64 " instructions, "
+           "%.4f MIPS\n", core.get_core_id(), core.get_num_cycles(),
+           core.get_num_instructions(), core.get_num_instructions() / t / 1e6);
+    print_cache_stats(core);
+}
 
 void usage(const char* name) {
     fprintf(stderr, "Usage: %s [-e file] [-b file] ", name);
-    fprintf(stderr, "[-t file] [-p port] [-m size] [-i num] [-w] [-x]\n");
+    fprintf(stderr, "[-t file] [-M file] [-p port] [-m size] [-i num] [-w] ");
+    fprintf(stderr, "[-x] [-H] [-E] [-r file] [-s file] [-D spec] ");
+    fprintf(stderr, "[-I spec] [-T spec] [-c num] [-q cycles] [-a] [-R] ");
+    fprintf(stderr, "[--batch file] [-j num] [--record file] ");
+    fprintf(stderr, "[--replay file] [--fork num] [--fork-params list] ");
+    fprintf(stderr, "[--roi-insn num] [--large-pages]\n");
     fprintf(stderr, "Arguments:\n");
     fprintf(stderr, "  -e <file>   elf binary to load into memory\n");
     fprintf(stderr, "  -b <file>   raw binary image to load into memory\n");
     fprintf(stderr, "  -t <file>   trace file to store trace information\n");
+    fprintf(stderr, "  -M <file>   binary trace of data memory accesses\n");
     fprintf(stderr, "  -p <port>   port number for debugger connection\n");
     fprintf(stderr, "  -m <size>   simulated memory size (in bytes)\n");
     fprintf(stderr, "  -i <n>      number of instructions to simulate\n");
     fprintf(stderr, "  -w          show warnings from debugger\n");
     fprintf(stderr, "  -z          disable instruction decode caching\n");
+    fprintf(stderr, "  -H          back simulated memory with huge pages\n");
+    fprintf(stderr, "  -E          store memory words in host byte order\n");
+    fprintf(stderr, "  -r <file>   restore checkpoint before simulation\n");
+    fprintf(stderr, "  -s <file>   save checkpoint after simulation\n");
+    fprintf(stderr, "  -D <spec>   model data cache, see README for spec\n");
+    fprintf(stderr, "  -I <spec>   model insn cache, see README for spec\n");
+    fprintf(stderr, "  -T <spec>   model insn timing, see README for spec\n");
+    fprintf(stderr, "  -c <n>      number of cores to simulate\n");
+    fprintf(stderr, "  -q <n>      cycles simulated between device updates\n");
+    fprintf(stderr, "  -a          pin each thread to its own host cpu\n");
+    fprintf(stderr, "  -R          pace simulation to run in real-time\n");
+    fprintf(stderr, "  --batch <f> run all programs listed in file f\n");
+    fprintf(stderr, "  -j <n>      number of threads running cores or jobs\n");
+    fprintf(stderr, "  --record <f> record host dependent inputs to f\n");
+    fprintf(stderr, "  --replay <f> replay inputs recorded in f\n");
+    fprintf(stderr, "  --fork <n>  fork n children at region of interest\n");
+    fprintf(stderr, "  --fork-params <list> fork one child per parameter\n");
+    fprintf(stderr, "  --roi-insn <n> region of interest starts at insn n\n");
+    fprintf(stderr, "  --large-pages honor L bit in level 1 page tables\n");
 }
 
 int main(int argc, char** argv) {
     char* elffile                   = NULL;
     char* binary                    = NULL;
     char* tracefile                 = NULL;
+    char* memtracefile              = NULL;
+    char* restorefile               = NULL;
+    char* savefile                  = NULL;
+    char* dcache                    = NULL;
+    char* icache                    = NULL;
+    char* timing                    = NULL;
+    char* batchfile                 = NULL;
+    char* recordfile                = NULL;
+    char* replayfile                = NULL;
+    char* forkparams                = NULL;
     unsigned short debugport        = 0;
     unsigned int memsize            = 0x08000000; // 128MB
     unsigned int ninsns             = 0;
+    unsigned int ncores             = 1;
+    unsigned int quantum            = SIM_QUANTUM;
+    unsigned int nthreads           = 0; // one per core, one for batch
+    unsigned int nforks             = 0;
+    uint64_t roiinsn                = 0;
+    bool pinned                     = false;
+    bool realtime                   = false;
     bool show_warn                  = false;
+    bool hugepages                  = false;
+    bool swapped                    = false;
+    bool largepages                 = false;
     or1kiss::decode_cache_size dcsz = or1kiss::DECODE_CACHE_SIZE_8M;
 
+    enum {
+        OPT_BATCH = 256,
+        OPT_RECORD,
+        OPT_REPLAY,
+        OPT_FORK,
+        OPT_FORK_PARAMS,
+        OPT_ROI_INSN,
+        OPT_LARGE_PAGES,
+    };
+
+    static const struct option longopts[] = {
+        { "batch", required_argument, NULL, OPT_BATCH },
+        { "record", required_argument, NULL, OPT_RECORD },
+        { "replay", required_argument, NULL, OPT_REPLAY },
+        { "fork", required_argument, NULL, OPT_FORK },
+        { "fork-params", required_argument, NULL, OPT_FORK_PARAMS },
+        { "roi-insn", required_argument, NULL, OPT_ROI_INSN },
+        { "large-pages", no_argument, NULL, OPT_LARGE_PAGES },
+        { NULL, 0, NULL, 0 },
+    };
+
     int c; // parse command line
-    while ((c = getopt(argc, argv, "e:b:t:p:m:i:vwxz")) != -1) {
+    const char* opts = "e:b:t:M:p:m:i:vwxzHEr:s:D:I:T:c:q:aRj:";
+    while ((c = getopt_long(argc, argv, opts, longopts, NULL)) != -1) {
         switch (c) {
         case 'e':
             elffile = optarg;
@@ -61,6 +225,9 @@ int main(int argc, char** argv) {
         case 't':
             tracefile = optarg;
             break;
+        case 'M':
+            memtracefile = optarg;
+            break;
         case 'p':
             debugport = atoi(optarg);
             break;
@@ -79,6 +246,63 @@ int main(int argc, char** argv) {
         case 'z':
             dcsz = or1kiss::DECODE_CACHE_OFF;
             break;
+        case 'H':
+            hugepages = true;
+            break;
+        case 'E':
+            swapped = true;
+            break;
+        case 'r':
+            restorefile = optarg;
+            break;
+        case 's':
+            savefile = optarg;
+            break;
+        case 'D':
+            dcache = optarg;
+            break;
+        case 'I':
+            icache = optarg;
+            break;
+        case 'T':
+            timing = optarg;
+            break;
+        case 'c':
+            ncores = atoi(optarg);
+            break;
+        case 'q':
+            quantum = atoi(optarg);
+            break;
+        case 'a':
+            pinned = true;
+            break;
+        case 'R':
+            realtime = true;
+            break;
+        case 'j':
+            nthreads = atoi(optarg);
+            break;
+        case OPT_BATCH:
+            batchfile = optarg;
+            break;
+        case OPT_RECORD:
+            recordfile = optarg;
+            break;
+        case OPT_REPLAY:
+            replayfile = optarg;
+            break;
+        case OPT_FORK:
+            nforks = atoi(optarg);
+            break;
+        case OPT_FORK_PARAMS:
+            forkparams = optarg;
+            break;
+        case OPT_ROI_INSN:
+            roiinsn = strtoull(optarg, NULL, 0);
+            break;
+        case OPT_LARGE_PAGES:
+            largepages = true;
+            break;
         case 'h':
             usage(argv[0]);
             return EXIT_SUCCESS;
@@ -89,59 +313,257 @@ int main(int argc, char** argv) {
     }
 
     // Check if we got a program to simulate
-    if ((elffile == NULL) && (binary == NULL) && (debugport == 0)) {
+    if ((elffile == NULL) && (binary == NULL) && (restorefile == NULL) &&
+        (debugport == 0) && (batchfile == NULL)) {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    if ((ncores == 0) || (quantum == 0)) {
         usage(argv[0]);
         return EXIT_FAILURE;
     }
 
+    if (recordfile && replayfile) {
+        fprintf(stderr, "--record and --replay are mutually exclusive\n");
+        return EXIT_FAILURE;
+    }
+
+    bool forking = nforks || forkparams;
+    if (roiinsn && !forking) {
+        fprintf(stderr, "--roi-insn requires --fork or --fork-params\n");
+        return EXIT_FAILURE;
+    }
+
+    // Parameters are passed in registers, which is only safe at l.nop 0x10
+    if (roiinsn && forkparams) {
+        fprintf(stderr, "--fork-params cannot be combined with --roi-insn\n");
+        return EXIT_FAILURE;
+    }
+
+    // Children would all write to the same trace, checkpoint and log files
+    if (forking && (tracefile || memtracefile || debugport || savefile ||
+                    ncores > 1 || recordfile || replayfile || batchfile)) {
+        fprintf(stderr, "--fork cannot be combined with -t, -M, -p, -s, "
+                        "-c, --record, --replay and --batch\n");
+        return EXIT_FAILURE;
+    }
+
+    // Batch jobs bring their own programs and run on a single core each
+    if (batchfile && (elffile || binary || tracefile || memtracefile ||
+                      debugport || restorefile || savefile || ncores > 1 ||
+                      recordfile || replayfile)) {
+        fprintf(stderr, "--batch cannot be combined with -e, -b, -t, -M, "
+                        "-p, -r, -s, -c, --record and --replay\n");
+        return EXIT_FAILURE;
+    }
+
+    if (batchfile) {
+        try {
+            batch jobs(batchfile, ninsns ? ninsns : ~0ull);
+            jobs.set_memory(memsize, swapped);
+            jobs.set_quantum(quantum);
+            if (dcsz == or1kiss::DECODE_CACHE_OFF)
+                jobs.set_decode_cache_size(dcsz);
+            jobs.set_setup([&](or1kiss::or1k& core) {
+                if (dcache)
+                    configure_cache(core.get_dcache(), dcache);
+                if (icache)
+                    configure_cache(core.get_icache(), icache);
+                if (timing)
+                    configure_timing(core, timing);
+                core.get_immu()->set_large_pages(largepages);
+                core.get_dmmu()->set_large_pages(largepages);
+            });
+
+            unsigned int failed = jobs.run(nthreads ? nthreads : 1);
+            return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+        } catch (std::exception& ex) {
+            fputs(ex.what(), stderr);
+            fputs("\n", stderr);
+            return EXIT_FAILURE;
+        }
+    }
+
+    // Debugger and checkpoints only know about a single core. Neither can
+    // replay reproduce how cores running on host threads interleave.
+    if ((ncores > 1) &&
+        (debugport || restorefile || savefile || recordfile || replayfile)) {
+        fprintf(stderr, "-p, -r, -s, --record and --replay require a single "
+                        "core\n");
+        return EXIT_FAILURE;
+    }
+
     try {
-        memory mem(memsize);
-        or1kiss::or1k sim(&mem, dcsz);
+        std::unique_ptr<sweep> children;
+        if (forkparams)
+            children.reset(new sweep(parse_params(forkparams)));
+        else if (nforks)
+            children.reset(new sweep(nforks));
+        if (children && nforks && children->get_num_children() != nforks)
+            OR1KISS_ERROR("got %u children but %zu parameters", nforks,
+                          children->get_num_children());
+
+        memory mem(memsize, hugepages);
+        mem.set_dmi_swapped(swapped);
+        std::vector<std::unique_ptr<or1kiss::or1k>> cores;
+        std::vector<or1kiss::or1k*> coreptrs;
+        for (unsigned int i = 0; i < ncores; i++) {
+            cores.emplace_back(new or1kiss::or1k(&mem, dcsz));
+            cores[i]->set_core_id(i);
+            cores[i]->set_numcores(ncores);
+            coreptrs.push_back(cores[i].get());
+
+            if (dcache)
+                configure_cache(cores[i]->get_dcache(), dcache);
+            if (icache)
+                configure_cache(cores[i]->get_icache(), icache);
+            if (timing)
+                configure_timing(*cores[i], timing);
+
+            cores[i]->get_immu()->set_large_pages(largepages);
+            cores[i]->get_dmmu()->set_large_pages(largepages);
+        }
 
+        if (children && !roiinsn)
+            cores[0]->enable_roi();
+
+        or1kiss::or1k& sim = *cores[0];
+        checkpoint ckpt(sim, mem);
+
+        // When restoring, the elf file is only used for debug symbols
         std::shared_ptr<or1kiss::elf> elf;
         if (elffile) {
             elf = std::make_shared<or1kiss::elf>(elffile);
-            elf->load(&mem);
+            if (!restorefile)
+                elf->load(&mem);
         }
 
-        if (binary)
+        if (binary && !restorefile)
             mem.load(binary);
 
-        if (tracefile)
-            sim.trace(tracefile);
+        if (restorefile)
+            ckpt.restore(restorefile);
+        if (savefile) // fail now rather than after a long simulation
+            ckpt.check_target(savefile);
+
+        // Additional cores trace into files suffixed with their core id
+        for (unsigned int i = 0; i < ncores; i++) {
+            std::string suffix = i ? "." + std::to_string(i) : "";
+            if (tracefile)
+                cores[i]->trace(tracefile + suffix);
+            if (memtracefile)
+                cores[i]->trace_memory(memtracefile + suffix);
+        }
+
+        if (recordfile)
+            sim.record_inputs(recordfile);
+        if (replayfile)
+            sim.replay_inputs(replayfile);
+
+        uart uart0("uart0", UART_BASE);
+        uart0.connect(&sim, UART_IRQ);
+        mem.attach(&uart0);
+
+        timer timer0("timer0", TIMER_BASE);
+        timer0.connect(&sim, TIMER_IRQ);
+        mem.attach(&timer0);
+
+        std::shared_ptr<or1kiss::gdb> debugger;
+        if (debugport != 0) {
+            debugger = std::make_shared<or1kiss::gdb>(sim, debugport);
+            if (elf)
+                debugger->set_elf(elf.get());
+            debugger->show_warnings(show_warn);
+        }
+
+        // Pacing starts right before simulation, after all the loading
+        for (unsigned int i = 0; realtime && i < ncores; i++)
+            cores[i]->set_realtime();
 
         timeval t1, t2;
         gettimeofday(&t1, NULL);
 
-        if (debugport == 0) {
-            if (ninsns > 0)
-                sim.step(ninsns);
-            else
-                sim.run();
+        // Simulate in quanta, so that devices get updated in between
+        uint64_t budget        = ninsns ? ninsns : ~0ull;
+        or1kiss::step_result r = or1kiss::STEP_OK;
+        std::unique_ptr<cluster> smp;
+        if (ncores > 1) {
+            smp.reset(new cluster(mem, coreptrs, quantum, pinned, nthreads));
+            smp->run(budget);
         } else {
-            or1kiss::gdb debugger(sim, debugport);
-            if (elf)
-                debugger.set_elf(elf.get());
-            debugger.show_warnings(show_warn);
-            if (ninsns > 0)
-                debugger.step(ninsns);
-            else
-                debugger.run();
+            while ((r == or1kiss::STEP_OK) && (budget > 0)) {
+                // Do not step past the region of interest
+                bool roi = children && !children->is_child() && roiinsn;
+                uint64_t limit = roi ? roiinsn - sim.get_num_instructions()
+                                     : budget;
+
+                unsigned int cycles = std::min<uint64_t>(quantum, budget);
+                cycles = std::min<uint64_t>(cycles, limit);
+                r = debugger ? debugger->step(cycles) : sim.step(cycles);
+                budget -= std::min<uint64_t>(cycles, budget);
+                mem.update_devices();
+
+                roi = roi && sim.get_num_instructions() >= roiinsn;
+                if (r == or1kiss::STEP_ROI || roi) {
+                    printf("(or1kiss) info: forking %zu children at "
+                           "instruction %llu\n", children->get_num_children(),
+                           (unsigned long long)sim.get_num_instructions());
+                    if (!children->fork(sim, r == or1kiss::STEP_ROI))
+                        return children->report() ? EXIT_FAILURE
+                                                  : EXIT_SUCCESS;
+                    r = or1kiss::STEP_OK;
+                }
+            }
         }
 
         gettimeofday(&t2, NULL);
+
+        if (savefile)
+            ckpt.save(savefile);
+
+        uint64_t ninstructions = 0;
+        for (auto& core : cores)
+            ninstructions += core->get_num_instructions();
+
         double t = (t2.tv_sec - t1.tv_sec) + (t2.tv_usec - t1.tv_usec) * 1e-6;
-        double mips     = sim.get_num_instructions() / t / 1e6;
+        double mips     = ninstructions / t / 1e6;
         double duration = sim.get_num_cycles() / (double)sim.get_clock();
 
         printf("simulation exit\n");
+        for (unsigned int i = 0; ncores > 1 && i < ncores; i++)
+            print_core_stats(*cores[i], t);
+
+        if (smp) {
+            uint64_t parked = smp->get_num_parked();
+            uint64_t total  = parked + smp->get_num_steps();
+            printf("# threads      : %u\n", smp->get_num_threads());
+            printf("# parked       : %" PRIu64 " of %" PRIu64 " core quanta\n",
+                   parked, total);
+        }
+
         printf("# cycles       : %" PRId64 "\n", sim.get_num_cycles());
-        printf("# instructions : %" PRId64 "\n", sim.get_num_instructions());
-        printf("# dcc hit rate : %f\n", sim.get_decode_cache_hit_rate());
+        printf("# instructions : %" PRId64 "\n", ninstructions);
+        if (ncores == 1)
+            print_cache_stats(sim);
         printf("# sim duration : %.4f seconds\n", duration);
         printf("# sim speed    : %.4f MIPS\n", mips);
         printf("# time taken   : %.4f seconds\n", t);
 
+        if (realtime) {
+            printf("# rt behind    : %" PRIu64 " of %" PRIu64 " checks\n",
+                   sim.get_realtime_behind(), sim.get_realtime_checks());
+            printf("# rt max lag   : %.4f ms\n",
+                   sim.get_realtime_max_lag() / 1e6);
+            printf("# rt avg lag   : %.4f ms\n",
+                   sim.get_realtime_avg_lag() / 1e6);
+        }
+
+        // Children fail like batch jobs do, so that the parent counts them
+        if (children && children->is_child() && r == or1kiss::STEP_EXIT &&
+            sim.gpr[3] != 0)
+            return EXIT_FAILURE;
+
         return EXIT_SUCCESS;
 
     } catch (std::exception& ex) {
@@ -16,45 +16,425 @@
  *                                                                            *
  ******************************************************************************/
 
+#include <sys/mman.h>
+#include <sys/stat.h>
+
 #include "memory.h"
 
-memory::memory(uint64_t size):
+#define HUGEPAGE_SIZE (2ull << 20)
+
+static uint64_t round_up(uint64_t size, uint64_t align) {
+    return (size + align - 1) & ~(align - 1);
+}
+
+memory::memory(uint64_t size, bool hugepages):
     or1kiss::env(or1kiss::ENDIAN_BIG),
     m_size(size),
-    m_memory(new unsigned char[size]()) {
+    m_mapped(round_up(size, getpagesize())),
+    m_page_size(getpagesize()),
+    m_memory(NULL),
+    m_tracking(false),
+    m_dirty(),
+    m_restore(),
+    m_snapshot(NULL),
+    m_devices(),
+    m_device_lock() {
+    // Guest memory is reserved but not committed: the kernel hands out
+    // zero pages on first touch, so we only pay for what the guest uses.
+    const int prot  = PROT_READ | PROT_WRITE;
+    const int flags = MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE;
+
+    void* ptr = MAP_FAILED;
+    if (hugepages) {
+        // Try a hugetlbfs backed mapping first; this only works if the
+        // administrator has reserved enough huge pages for us. Without
+        // a reservation, we would get SIGBUS on first touch instead.
+        uint64_t hsize = round_up(size, HUGEPAGE_SIZE);
+        int hflags     = (flags & ~MAP_NORESERVE) | MAP_HUGETLB;
+
+        ptr = mmap(NULL, hsize, prot, hflags, -1, 0);
+        if (ptr != MAP_FAILED) {
+            m_mapped    = hsize;
+            m_page_size = HUGEPAGE_SIZE;
+        }
+    }
+
+    if (ptr == MAP_FAILED) {
+        ptr = mmap(NULL, m_mapped, prot, flags, -1, 0);
+        if (ptr == MAP_FAILED)
+            OR1KISS_ERROR("cannot allocate %" PRIu64 " bytes memory: %s",
+                          size, strerror(errno));
+
+        // Fall back to transparent huge pages, if the user asked for them.
+        if (hugepages && madvise(ptr, m_mapped, MADV_HUGEPAGE))
+            fprintf(stderr, "(memory) huge pages unavailable: %s\n",
+                    strerror(errno));
+    }
+
+    m_memory = (unsigned char*)ptr;
+
     set_data_ptr(m_memory, 0, size - 1, 1);
     set_insn_ptr(m_memory, 0, size - 1, 0);
 }
 
 memory::~memory() {
-    delete[] m_memory;
+    track_dirty(false);
+    munmap(m_memory, m_mapped);
+}
+
+// There is only one SIGSEGV handler per process, which asks each memory
+// tracking dirty pages in turn. The list only ever grows, so the handler can
+// walk it without locking; entries are reused once a memory stops tracking.
+// Faults outside of all memories are forwarded to the previously installed
+// handler by reinstalling it and returning, so that the access is retried.
+struct tracked_memory {
+    memory* mem;
+    tracked_memory* next;
+};
+
+static tracked_memory* g_tracked = NULL;
+static unsigned int g_num_tracked = 0;
+static std::mutex g_tracked_lock;
+static struct sigaction g_prev_action;
+
+static void handle_segv(int sig, siginfo_t* info, void* context) {
+    tracked_memory* t = __atomic_load_n(&g_tracked, __ATOMIC_ACQUIRE);
+    for (; t != NULL; t = t->next) {
+        memory* mem = __atomic_load_n(&t->mem, __ATOMIC_ACQUIRE);
+        if (mem && mem->handle_fault(info->si_addr))
+            return;
+    }
+
+    sigaction(SIGSEGV, &g_prev_action, NULL);
+}
+
+static void start_tracking(memory* mem) {
+    std::lock_guard<std::mutex> guard(g_tracked_lock);
+    if (g_num_tracked++ == 0) {
+        struct sigaction sa;
+        memset(&sa, 0, sizeof(sa));
+        sa.sa_sigaction = &handle_segv;
+        sa.sa_flags     = SA_SIGINFO;
+        sigemptyset(&sa.sa_mask);
+
+        if (sigaction(SIGSEGV, &sa, &g_prev_action))
+            OR1KISS_ERROR("sigaction failed: %s", strerror(errno));
+    }
+
+    for (tracked_memory* t = g_tracked; t != NULL; t = t->next) {
+        if (t->mem == NULL) {
+            __atomic_store_n(&t->mem, mem, __ATOMIC_RELEASE);
+            return;
+        }
+    }
+
+    tracked_memory* t = new tracked_memory { mem, g_tracked };
+    __atomic_store_n(&g_tracked, t, __ATOMIC_RELEASE);
+}
+
+static void stop_tracking(memory* mem) {
+    std::lock_guard<std::mutex> guard(g_tracked_lock);
+    for (tracked_memory* t = g_tracked; t != NULL; t = t->next) {
+        if (t->mem == mem)
+            __atomic_store_n(&t->mem, (memory*)NULL, __ATOMIC_RELEASE);
+    }
+
+    if (--g_num_tracked == 0)
+        sigaction(SIGSEGV, &g_prev_action, NULL);
+}
+
+bool memory::is_dirty(uint64_t page) const {
+    if (!m_tracking || page >= get_num_pages())
+        return false;
+    return m_dirty[page / 64] & (1ull << (page % 64));
+}
+
+void memory::track_dirty(bool enable) {
+    release_snapshot();
+
+    if (m_tracking)
+        stop_tracking(this);
+
+    m_tracking = false;
+    if (mprotect(m_memory, m_mapped, PROT_READ | PROT_WRITE))
+        OR1KISS_ERROR("mprotect failed: %s", strerror(errno));
+
+    if (!enable)
+        return;
+
+    // Write protect everything, the first write to each page will then
+    // trap into handle_segv, which marks the page and lifts the protection.
+    m_dirty.assign((get_num_pages() + 63) / 64, 0);
+    m_tracking = true;
+    start_tracking(this);
+
+    if (mprotect(m_memory, m_mapped, PROT_READ))
+        OR1KISS_ERROR("mprotect failed: %s", strerror(errno));
+}
+
+bool memory::handle_fault(void* addr) {
+    unsigned char* ptr = (unsigned char*)addr;
+    if (!m_tracking || ptr < m_memory || ptr >= m_memory + m_mapped)
+        return false;
+
+    uint64_t page = (ptr - m_memory) / m_page_size;
+    uint64_t offs = page * m_page_size;
+
+    // Only the thread that marks the page dirty saves its contents and
+    // lifts the protection. Others faulting on it concurrently just retry
+    // their access, faulting again until the page has become writable.
+    // With a snapshot, pages get protected again on every capture and
+    // restore, so it is the snapshot bitmap that decides.
+    uint64_t bit    = 1ull << (page % 64);
+    uint64_t* marks = m_snapshot ? m_restore.data() : m_dirty.data();
+    if (__atomic_fetch_or(&marks[page / 64], bit, __ATOMIC_ACQ_REL) & bit)
+        return true;
+
+    if (m_snapshot) {
+        __atomic_fetch_or(&m_dirty[page / 64], bit, __ATOMIC_RELAXED);
+        memcpy(m_snapshot + offs, m_memory + offs, m_page_size);
+    }
+
+    return mprotect(m_memory + offs, m_page_size,
+                    PROT_READ | PROT_WRITE) == 0;
+}
+
+void memory::release_snapshot() {
+    if (m_snapshot == NULL)
+        return;
+
+    munmap(m_snapshot, m_mapped);
+    m_snapshot = NULL;
+}
+
+void memory::capture_snapshot() {
+    // Capturing is cheap: we only write protect memory and reserve space
+    // for the original page contents, which handle_fault fills in lazily
+    // upon the first write to each page. Pages already recorded as dirty
+    // for a checkpoint stay recorded.
+    release_snapshot();
+
+    const int prot  = PROT_READ | PROT_WRITE;
+    const int flags = MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE;
+
+    void* ptr = mmap(NULL, m_mapped, prot, flags, -1, 0);
+    if (ptr == MAP_FAILED)
+        OR1KISS_ERROR("cannot allocate snapshot memory: %s", strerror(errno));
+
+    if (!m_tracking)
+        track_dirty(true);
+    else if (mprotect(m_memory, m_mapped, PROT_READ))
+        OR1KISS_ERROR("mprotect failed: %s", strerror(errno));
+
+    m_restore.assign(m_dirty.size(), 0);
+    m_snapshot = (unsigned char*)ptr;
+}
+
+void memory::restore_snapshot(std::vector<uint64_t>& pages) {
+    if (m_snapshot == NULL)
+        OR1KISS_ERROR("no memory snapshot captured");
+
+    // Copy back only the pages written since capture and protect them
+    // again; pages is filled with their indices for the caller.
+    pages.clear();
+    for (uint64_t i = 0; i < m_restore.size(); i++) {
+        uint64_t bits = m_restore[i];
+        m_restore[i]  = 0;
+
+        while (bits) {
+            uint64_t page = i * 64 + __builtin_ctzll(bits);
+            uint64_t offs = page * m_page_size;
+            bits &= bits - 1;
+
+            memcpy(m_memory + offs, m_snapshot + offs, m_page_size);
+            if (mprotect(m_memory + offs, m_page_size, PROT_READ))
+                OR1KISS_ERROR("mprotect failed: %s", strerror(errno));
+
+            pages.push_back(page);
+        }
+    }
 }
 
 bool memory::load(const char* filename) {
-    std::ifstream file(filename, std::ios::binary | std::ios::ate);
-    if (!file.is_open())
+    int fd = open(filename, O_RDONLY, 0);
+    if (fd < 0)
         return false;
 
-    uint64_t fsize = file.tellg();
-    fsize          = std::min(fsize, m_size);
-    file.seekg(0, std::ios::beg);
-    file.read((char*)m_memory, fsize);
+    struct stat st;
+    if (fstat(fd, &st) < 0) {
+        close(fd);
+        return false;
+    }
+
+    uint64_t fsize = std::min((uint64_t)st.st_size, m_size);
+    bool success   = map_file(fd, 0, 0, fsize);
+
+    close(fd);
+    return success;
+}
+
+static bool read_file(int fd, uint64_t offset, unsigned char* dest,
+                      uint64_t size) {
+    while (size > 0) {
+        ssize_t n = pread(fd, dest, size, offset);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return false;
+
+        dest   += n;
+        offset += n;
+        size   -= n;
+    }
+
+    return true;
+}
+
+// Files hold data in system byte order, so with word swapped memory we
+// cannot map them but need to convert everything while reading.
+static bool read_file_swapped(int fd, uint64_t offset, unsigned char* dest,
+                              uint64_t size) {
+    std::vector<unsigned char> buf(std::min<uint64_t>(size, 1ull << 20));
+    while (size > 0) {
+        uint64_t n = std::min<uint64_t>(size, buf.size());
+        if (!read_file(fd, offset, buf.data(), n))
+            return false;
+
+        or1kiss::memcpy_to_words(dest, buf.data(), n);
+        dest   += n;
+        offset += n;
+        size   -= n;
+    }
+
     return true;
 }
 
+bool memory::map_file(int fd, uint64_t offset, uint32_t addr,
+                      uint64_t size) {
+    if ((addr >= m_size) || (size > m_size - addr))
+        return false;
+
+    // Neither mapping over tracked pages nor reading into them would fault,
+    // so mark them written first and copy the file contents.
+    if (m_tracking) {
+        for (uint64_t offs = addr & ~(m_page_size - 1); offs < addr + size;
+             offs += m_page_size)
+            handle_fault(m_memory + offs);
+    }
+
+    if (is_dmi_swapped())
+        return read_file_swapped(fd, offset, m_memory + addr, size);
+    if (m_tracking)
+        return read_file(fd, offset, m_memory + addr, size);
+
+    // Pages that are fully covered by the file range get mapped privately
+    // on top of our memory, so that the kernel pages them in on demand and
+    // shares them with its page cache until the guest writes to them. This
+    // requires file offset and target address to be congruent modulo the
+    // page size. Partial pages at either end are copied instead.
+    uint64_t pgsz  = getpagesize();
+    uint64_t start = round_up(addr, pgsz);
+    uint64_t end   = (addr + size) & ~(pgsz - 1);
+
+    if (((offset - addr) & (pgsz - 1)) || (start >= end))
+        return read_file(fd, offset, m_memory + addr, size);
+
+    const int prot  = PROT_READ | PROT_WRITE;
+    const int flags = MAP_PRIVATE | MAP_FIXED;
+
+    void* ptr = mmap(m_memory + start, end - start, prot, flags, fd,
+                     offset + start - addr);
+    if (ptr == MAP_FAILED) // e.g. hugetlbfs backed memory
+        return read_file(fd, offset, m_memory + addr, size);
+
+    return read_file(fd, offset, m_memory + addr, start - addr) &&
+           read_file(fd, offset + end - addr, m_memory + end,
+                     addr + size - end);
+}
+
+void memory::attach(device* dev) {
+    if ((uint64_t)dev->get_base() < m_size)
+        OR1KISS_ERROR("device %s overlaps with memory", dev->get_name());
+
+    auto it = std::lower_bound(m_devices.begin(), m_devices.end(), dev,
+                               [](const device* a, const device* b) {
+                                   return a->get_base() < b->get_base();
+                               });
+
+    if (it != m_devices.end() && (*it)->get_base() <= dev->get_end())
+        OR1KISS_ERROR("device %s overlaps with %s", dev->get_name(),
+                      (*it)->get_name());
+    if (it != m_devices.begin() && (*(it - 1))->get_end() >= dev->get_base())
+        OR1KISS_ERROR("device %s overlaps with %s", dev->get_name(),
+                      (*(it - 1))->get_name());
+
+    m_devices.insert(it, dev);
+}
+
+void memory::detach(device* dev) {
+    m_devices.erase(std::remove(m_devices.begin(), m_devices.end(), dev),
+                    m_devices.end());
+}
+
+device* memory::find_device(uint32_t addr) const {
+    // Find the last device starting at or below addr
+    auto it = std::upper_bound(m_devices.begin(), m_devices.end(), addr,
+                               [](uint32_t a, const device* dev) {
+                                   return a < dev->get_base();
+                               });
+
+    if (it == m_devices.begin())
+        return NULL;
+
+    device* dev = *(it - 1);
+    return addr <= dev->get_end() ? dev : NULL;
+}
+
+void memory::update_devices() {
+    std::lock_guard<std::mutex> guard(m_device_lock);
+    for (device* dev : m_devices)
+        dev->update();
+}
+
+or1kiss::response memory::device_transact(device* dev,
+                                          const or1kiss::request& req) {
+    std::lock_guard<std::mutex> guard(m_device_lock);
+
+    unsigned char* data = (unsigned char*)req.data;
+    uint32_t offset     = req.addr - dev->get_base();
+
+    or1kiss::response resp = req.is_write()
+                                 ? dev->write(offset, data, req.size)
+                                 : dev->read(offset, data, req.size);
+
+    if (!req.is_debug())
+        req.cycles = dev->get_latency();
+    return resp;
+}
+
 or1kiss::response memory::transact(const or1kiss::request& req) {
     if ((req.addr + req.size) > m_size) {
+        // Everything outside of memory is either a device or unmapped
+        device* dev = find_device(req.addr);
+        if (dev && dev->contains(req.addr, req.size))
+            return device_transact(dev, req);
+
         if (!req.is_debug()) {
             fprintf(stderr, "(memory) bus error at address 0x%08" PRIx32 "\n",
                     req.addr);
             fflush(stderr);
-            std::exit(-1);
         }
 
         return or1kiss::RESP_ERROR;
     }
 
-    if (req.is_write()) {
+    if (is_dmi_swapped()) {
+        if (req.is_write())
+            or1kiss::memcpy_to_words(m_memory + req.addr, req.data, req.size);
+        else
+            or1kiss::memcpy_from_words(req.data, m_memory + req.addr,
+                                       req.size);
+    } else if (req.is_write()) {
         switch (req.size) {
         case or1kiss::SIZE_BYTE:
             *(uint8_t*)(m_memory + req.addr) = *(uint8_t*)req.data;
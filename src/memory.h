@@ -21,29 +21,70 @@
 
 #include <cstdlib>
 #include <cstdio>
+#include <vector>
+#include <mutex>
 
 #include "or1kiss.h"
+#include "device.h"
 
 class memory : public or1kiss::env
 {
 private:
     uint64_t m_size;
+    uint64_t m_mapped;
+    uint64_t m_page_size;
     unsigned char* m_memory;
 
+    bool m_tracking;
+    std::vector<uint64_t> m_dirty;    // pages written since track_dirty
+    std::vector<uint64_t> m_restore;  // pages written since the snapshot
+    unsigned char* m_snapshot;
+
+    std::vector<device*> m_devices; // sorted by base address
+    std::mutex m_device_lock;       // serializes accesses from all cores
+
+    void release_snapshot();
+
+    or1kiss::response device_transact(device* dev,
+                                      const or1kiss::request& req);
+
     // Disabled
     memory();
     memory(const memory&);
 
 public:
-    memory(uint64_t size);
+    memory(uint64_t size, bool hugepages = false);
     virtual ~memory();
 
     unsigned char* get_ptr() const { return m_memory; }
     uint64_t get_size() const { return m_size; }
 
+    uint64_t get_page_size() const { return m_page_size; }
+    uint64_t get_num_pages() const { return m_mapped / m_page_size; }
+
+    bool is_tracking() const { return m_tracking; }
+    bool is_dirty(uint64_t page) const;
+
+    void track_dirty(bool enable = true);
+    bool handle_fault(void* addr);
+
+    // In-process snapshots: restoring copies back only the pages written
+    // since the capture and fills pages with their indices. Snapshots can
+    // be taken while tracking for a checkpoint, but track_dirty drops them.
+    bool has_snapshot() const { return m_snapshot != NULL; }
+    void capture_snapshot();
+    void restore_snapshot(std::vector<uint64_t>& pages);
+
     bool load(const char*);
 
+    void attach(device* dev);
+    void detach(device* dev);
+    device* find_device(uint32_t addr) const;
+    void update_devices();
+
     virtual or1kiss::response transact(const or1kiss::request& reg);
+    virtual bool map_file(int fd, uint64_t offset, uint32_t addr,
+                          uint64_t size);
 };
 
 #endif
@@ -0,0 +1,61 @@
+/******************************************************************************
+ *                                                                            *
+ * Copyright 2018 Jan Henrik Weinstock                                        *
+ *                                                                            *
+ * Licensed under the Apache License, Version 2.0 (the "License");            *
+ * you may not use this file except in compliance with the License.           *
+ * You may obtain a copy of the License at                                    *
+ *                                                                            *
+ *     http://www.apache.org/licenses/LICENSE-2.0                             *
+ *                                                                            *
+ * Unless required by applicable law or agreed to in writing, software        *
+ * distributed under the License is distributed on an "AS IS" BASIS,          *
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.   *
+ * See the License for the specific language governing permissions and        *
+ * limitations under the License.                                             *
+ *                                                                            *
+ ******************************************************************************/
+
+#include <iostream>
+#include <exception>
+#include <or1kiss.h>
+
+void usage(const char* name) {
+    fprintf(stderr, "Usage: %s <trace> [output]\n", name);
+    fprintf(stderr, "Converts a binary memory trace to text, one access per ");
+    fprintf(stderr, "line. Writes to stdout\nunless an output file is ");
+    fprintf(stderr, "given.\n");
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2 || argc > 3 || !strcmp(argv[1], "-h")) {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    try {
+        or1kiss::memtrace_reader reader(argv[1]);
+
+        FILE* out = stdout;
+        if (argc > 2 && (out = fopen(argv[2], "w")) == NULL)
+            OR1KISS_ERROR("cannot open '%s': %s", argv[2], strerror(errno));
+
+        or1kiss::memtrace_record rec;
+        while (reader.next(rec)) {
+            fprintf(out, "%" PRIu64 " %c%c%c %08x %u %0*" PRIx64 "\n",
+                    rec.cycle, rec.write ? 'W' : 'R', rec.excl ? 'X' : '-',
+                    rec.super ? 'S' : 'U', rec.addr, rec.size,
+                    (int)rec.size * 2, rec.value);
+        }
+
+        if (out != stdout)
+            fclose(out);
+
+        return EXIT_SUCCESS;
+
+    } catch (std::exception& ex) {
+        fputs(ex.what(), stderr);
+        fputs("\n", stderr);
+        return EXIT_FAILURE;
+    }
+}
@@ -0,0 +1,156 @@
+/******************************************************************************
+ *                                                                            *
+ * Copyright 2018 Jan Henrik Weinstock                                        *
+ *                                                                            *
+ * Licensed under the Apache License, Version 2.0 (the "License");            *
+ * you may not use this file except in compliance with the License.           *
+ * You may obtain a copy of the License at                                    *
+ *                                                                            *
+ *     http://www.apache.org/licenses/LICENSE-2.0                             *
+ *                                                                            *
+ * Unless required by applicable law or agreed to in writing, software        *
+ * distributed under the License is distributed on an "AS IS" BASIS,          *
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.   *
+ * See the License for the specific language governing permissions and        *
+ * limitations under the License.                                             *
+ *                                                                            *
+ ******************************************************************************/
+
+#include "or1kiss/cache.h"
+
+namespace or1kiss {
+
+u32 cache::find_way(const u32* set, u32 tag) const {
+#ifdef __SSE2__
+    // Sets are padded to a multiple of four ways with invalid tags, so we
+    // can always compare four ways at once.
+    const __m128i key = _mm_set1_epi32(tag);
+    for (u32 way = 0; way < m_num_ways; way += 4) {
+        __m128i tags = _mm_loadu_si128((const __m128i*)(set + way));
+        __m128i cmp  = _mm_cmpeq_epi32(tags, key);
+        int mask     = _mm_movemask_ps(_mm_castsi128_ps(cmp));
+        if (mask)
+            return way + ffs32(mask) - 1;
+    }
+#else
+    for (u32 way = 0; way < m_num_ways; way++) {
+        if (set[way] == tag)
+            return way;
+    }
+#endif
+
+    return m_num_ways;
+}
+
+u32 cache::refill(u32 tag) {
+    u32* set = lookup_set(tag);
+    u32 way  = find_way(set, tag);
+    u32 cost = 0;
+
+    if (way < m_num_ways) {
+        m_hits++;
+    } else {
+        m_misses++;
+        way  = m_num_ways - 1; // evict least recently used block
+        cost = m_penalty;
+    }
+
+    memmove(set + 1, set, way * sizeof(*set));
+    set[0] = m_last = tag;
+    return cost;
+}
+
+void cache::update(u32 tag) {
+    u32* set = lookup_set(tag);
+    u32 way  = find_way(set, tag);
+
+    // Write misses go straight to memory without allocating a block
+    if (way == m_num_ways) {
+        m_misses++;
+        return;
+    }
+
+    m_hits++;
+    memmove(set + 1, set, way * sizeof(*set));
+    set[0] = m_last = tag;
+}
+
+cache::cache():
+    m_cfg(0),
+    m_num_sets(0),
+    m_num_ways(0),
+    m_stride(0),
+    m_set_mask(0),
+    m_block_bits(4),
+    m_penalty(0),
+    m_last(0),
+    m_tags(),
+    m_hits(0),
+    m_misses(0) {
+    /* Nothing to do */
+}
+
+cache::~cache() {
+    /* Nothing to do */
+}
+
+void cache::configure(u32 size, u32 ways, u32 block, u32 penalty) {
+    m_hits   = 0;
+    m_misses = 0;
+    m_last   = 0;
+
+    if (size == 0) {
+        m_cfg = m_num_sets = m_num_ways = m_stride = m_set_mask = 0;
+        m_tags.clear();
+        return;
+    }
+
+    if (block != 16 && block != 32)
+        OR1KISS_ERROR("cache block size must be 16 or 32 bytes");
+    if (ways == 0 || ways > OR1KISS_CACHE_MAX_WAYS || (ways & (ways - 1)))
+        OR1KISS_ERROR("invalid number of cache ways: %u", ways);
+    if (size % (ways * block))
+        OR1KISS_ERROR("cache size %u not a multiple of way size", size);
+
+    u32 sets = size / (ways * block);
+    if (sets > OR1KISS_CACHE_MAX_SETS || (sets & (sets - 1)))
+        OR1KISS_ERROR("invalid number of cache sets: %u", sets);
+
+    m_num_sets   = sets;
+    m_num_ways   = ways;
+    m_stride     = (ways + 3) & ~3u;
+    m_set_mask   = sets - 1;
+    m_block_bits = fls32(block) - 1;
+    m_penalty    = penalty;
+    m_tags.assign(m_num_sets * m_stride, 0);
+
+    m_cfg = (fls32(ways) - 1) | (fls32(sets) - 1) << 3 | CCFGR_CBIRI |
+            CCFGR_CBFRI;
+    if (block == 32)
+        m_cfg |= CCFGR_CBS;
+}
+
+void cache::invalidate(u32 addr) {
+    if (!is_enabled())
+        return;
+
+    u32 tag  = make_tag(addr);
+    u32* set = lookup_set(tag);
+    u32 way  = find_way(set, tag);
+    if (way == m_num_ways)
+        return;
+
+    // Keep the invalid tag out of the way of the valid ones
+    memmove(set + way, set + way + 1, (m_num_ways - way - 1) * sizeof(*set));
+    set[m_num_ways - 1] = 0;
+
+    if (m_last == tag)
+        m_last = 0;
+}
+
+void cache::invalidate_all() {
+    std::fill(m_tags.begin(), m_tags.end(), 0);
+    m_last = 0;
+}
+
+} // namespace or1kiss
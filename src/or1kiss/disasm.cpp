@@ -162,6 +162,17 @@ static const char* g_opcode_str[NUM_OPCODES] = {
     "lf.cust1.d",
 };
 
+const char* opcode_name(opcode op) {
+    return (op < NUM_OPCODES) ? g_opcode_str[op] : g_opcode_str[0];
+}
+
+opcode find_opcode(const string& name) {
+    for (int op = INVALID_OPCODE + 1; op < NUM_OPCODES; op++)
+        if (name == g_opcode_str[op])
+            return static_cast<opcode>(op);
+    return INVALID_OPCODE;
+}
+
 static string reg_d(u32 insn) {
     std::stringstream ss;
     ss << "r" << bits32(insn, 25, 21);
@@ -51,11 +51,13 @@ elf_section::elf_section(Elf* elf, Elf_Scn* scn):
     m_name(),
     m_data(),
     m_size(),
+    m_offset(),
     m_virt_addr(),
     m_phys_addr(),
     m_flag_alloc(),
     m_flag_write(),
-    m_flag_exec() {
+    m_flag_exec(),
+    m_flag_nobits() {
     Elf32_Ehdr* ehdr = elf32_getehdr(elf);
     Elf32_Phdr* phdr = elf32_getphdr(elf);
     Elf32_Shdr* shdr = elf32_getshdr(scn);
@@ -68,9 +70,10 @@ elf_section::elf_section(Elf* elf, Elf_Scn* scn):
     if (name == NULL)
         OR1KISS_ERROR("Call to elfstrptr failed (%s)", elf_errmsg(-1));
 
-    m_name = std::string(name);
-    m_size = shdr->sh_size;
-    m_data = new unsigned char[m_size];
+    m_name   = std::string(name);
+    m_size   = shdr->sh_size;
+    m_offset = shdr->sh_offset;
+    m_data   = new unsigned char[m_size](); // zero-fill NOBITS sections
 
     m_virt_addr = shdr->sh_addr;
     m_phys_addr = shdr->sh_addr;
@@ -79,6 +82,8 @@ elf_section::elf_section(Elf* elf, Elf_Scn* scn):
     m_flag_write = shdr->sh_flags & SHF_WRITE;
     m_flag_exec  = shdr->sh_flags & SHF_EXECINSTR;
 
+    m_flag_nobits = shdr->sh_type == SHT_NOBITS;
+
     // Check program headers for physical address
     for (unsigned int i = 0; i < ehdr->e_phnum; i++) {
         u64 start = phdr[i].p_offset;
@@ -100,7 +105,7 @@ elf_section::~elf_section() {
     delete[] m_data;
 }
 
-void elf_section::load(env* e, bool verbose) {
+void elf_section::load(env* e, bool verbose, int fd) {
     if (!m_flag_alloc)
         return;
 
@@ -110,6 +115,19 @@ void elf_section::load(env* e, bool verbose) {
     if (verbose)
         fprintf(stderr, "loading section '%s'... ", m_name.c_str());
 
+    // Try to map the section contents straight from the file first. This
+    // only works if the simulation memory uses the same byte order as the
+    // (big endian) file, since no conversion can take place.
+    if ((fd >= 0) && !m_flag_nobits &&
+        (e->get_system_endian() == ENDIAN_BIG) &&
+        e->map_file(fd, m_offset, m_phys_addr, m_size)) {
+        if (verbose) {
+            fprintf(stderr, "MAPPED [0x%08" PRIx64 "- 0x%08" PRIx64 "]\n",
+                    m_phys_addr, m_phys_addr + m_size);
+        }
+        return;
+    }
+
     request req;
     req.set_write();
     req.set_debug();
@@ -124,7 +142,13 @@ void elf_section::load(env* e, bool verbose) {
 
     req.set_big_endian();
 
-    if (e->convert_and_transact(req) != RESP_SUCCESS) {
+    // Section data is big endian, so it only needs to be converted if the
+    // simulation memory uses another byte order.
+    response resp = (e->get_system_endian() == ENDIAN_BIG)
+                        ? e->transfer_block(req)
+                        : e->convert_and_transact(req);
+
+    if (resp != RESP_SUCCESS) {
         fprintf(stderr,
                 "warning: cannot load section '%s' to memory [0x%08" PRIx64
                 " - 0x%08" PRIx64 "]",
@@ -236,8 +260,14 @@ void elf::load(env* e, bool verbose) {
     if (verbose)
         fprintf(stderr, "loading elf from '%s'\n", m_filename.c_str());
 
+    // Sections may be mapped from the file if the environment supports it,
+    // otherwise we fall back to copying them from our buffers.
+    int fd = open(m_filename.c_str(), O_RDONLY, 0);
     for (unsigned int i = 0; i < m_sections.size(); i++)
-        m_sections[i]->load(e, verbose);
+        m_sections[i]->load(e, verbose, fd);
+
+    if (fd >= 0)
+        close(fd);
 
     if (m_entry != 0x100)
         fprintf(stderr, "invalid entry point 0x%08" PRIx64 " ignored\n",
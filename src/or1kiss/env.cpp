@@ -17,11 +17,13 @@
  ******************************************************************************/
 
 #include "or1kiss/env.h"
+#include "or1kiss/insn.h"
 
 namespace or1kiss {
 
 env::env(endian e):
     m_endian(e),
+    m_dmi_swapped(false),
     m_data_ptr(NULL),
     m_data_start(0),
     m_data_end(0),
@@ -30,34 +32,99 @@ env::env(endian e):
     m_insn_start(0),
     m_insn_end(0),
     m_insn_cycles(0),
-    m_excl_addr(-1),
-    m_excl_data() {
+    m_default_monitor(),
+    m_monitor(&m_default_monitor),
+    m_decode_caches() {
     // nothing to do
 }
 
 response env::exclusive_access(unsigned char* ptr, request& req) {
+    u32 core = req.get_core_id();
     if (req.is_read()) {
-        m_excl_addr = req.addr;
         memcpy(req.data, ptr, req.size);
-        memcpy(&m_excl_data, req.data, req.size);
+        m_monitor->reserve(core, req.addr, *(u32*)req.data);
     } else {
-        if (req.addr != m_excl_addr)
-            return RESP_FAILED;
-        u32* val = (u32*)req.data;
-        if (!cas(ptr, m_excl_data, *val))
+        if (!m_monitor->store_conditional(core, req.addr, ptr,
+                                          *(u32*)req.data))
             return RESP_FAILED;
     }
 
     return RESP_SUCCESS;
 }
 
+response env::swapped_access(unsigned char* ptr, request& req) {
+    // Aligned accesses in host byte order find their data in place
+    if (req.get_endian() == host_endian() && req.size <= SIZE_WORD &&
+        req.is_aligned()) {
+        ptr = word_swizzle(ptr, req.size);
+        if (req.is_exclusive())
+            return exclusive_access(ptr, req);
+        if (req.is_read())
+            memcpy(req.data, ptr, req.size);
+        else
+            memcpy(ptr, req.data, req.size);
+        return RESP_SUCCESS;
+    }
+
+    if (req.is_exclusive())
+        OR1KISS_ERROR("unsupported exclusive access to swapped memory");
+
+    // Everything else goes through a buffer in system byte order
+    u64 buf   = 0;
+    void* tmp = (req.size > sizeof(buf)) ? malloc(req.size) : &buf;
+    bool conversion_necessary = (req.size > 1) &&
+                                (req.get_endian() != m_endian);
+
+    if (req.is_read()) {
+        memcpy_from_words(tmp, ptr, req.size);
+        if (conversion_necessary)
+            memcpyswp(req.data, tmp, req.size);
+        else
+            memcpy(req.data, tmp, req.size);
+    } else {
+        if (conversion_necessary)
+            memcpyswp(tmp, req.data, req.size);
+        else
+            memcpy(tmp, req.data, req.size);
+        memcpy_to_words(ptr, tmp, req.size);
+    }
+
+    if (req.size > sizeof(buf))
+        free(tmp);
+
+    return RESP_SUCCESS;
+}
+
+unsigned char* env::direct_memory_ptr(request& req, u64& size) const {
+    unsigned char* ptr = direct_memory_ptr(req);
+    if (ptr != NULL) {
+        u32 end = req.is_dmem() ? m_data_end : m_insn_end;
+        size    = (u64)end - req.addr + 1;
+    }
+
+    return ptr;
+}
+
+void env::attach(decode_cache* cache) {
+    if (!stl_contains(m_decode_caches, cache))
+        m_decode_caches.push_back(cache);
+}
+
+void env::detach(decode_cache* cache) {
+    stl_remove_erase(m_decode_caches, cache);
+}
+
 response env::convert_and_transact(request& req) {
     void* tmp = NULL;
     void* org = req.data;
 
     response resp = RESP_SUCCESS;
 
-    bool conversion_necessary = (req.size > 1) &&
+    // Word swapped memory takes care of endianess itself
+    unsigned char* ptr = direct_memory_ptr(req);
+    bool swapped       = (ptr != NULL) && m_dmi_swapped;
+
+    bool conversion_necessary = (req.size > 1) && !swapped &&
                                 (req.get_endian() != m_endian);
 
     u64 buf = 0;
@@ -69,10 +136,11 @@ response env::convert_and_transact(request& req) {
     }
 
     // Send request to the simulation system
-    unsigned char* ptr = direct_memory_ptr(req);
     if (ptr != NULL) {
         req.cycles += m_data_cycles;
-        if (req.is_exclusive())
+        if (swapped)
+            resp = swapped_access(ptr, req);
+        else if (req.is_exclusive())
             resp = exclusive_access(ptr, req);
         else if (req.is_read())
             memcpy(req.data, ptr, req.size);
@@ -85,6 +153,10 @@ response env::convert_and_transact(request& req) {
         req.set_endian(e);
     }
 
+    // Regular stores cancel reservations of all cores on that address
+    if (req.is_write() && !req.is_exclusive() && (resp == RESP_SUCCESS))
+        m_monitor->notify_store(req.addr, req.size);
+
     // Convert simulation endian to host endian
     if (conversion_necessary) {
         req.data = memcpyswp(org, req.data, req.size);
@@ -95,4 +167,54 @@ response env::convert_and_transact(request& req) {
     return resp;
 }
 
+response env::transfer_block(request& req) {
+    if (req.is_exclusive())
+        OR1KISS_ERROR("exclusive block transfers are not supported");
+
+    request chunk(req);
+    chunk.set_endian(m_endian);
+    chunk.cycles = 0;
+
+    unsigned char* data = (unsigned char*)req.data;
+    u32 addr            = req.addr;
+    u64 remaining       = req.size;
+
+    response resp = RESP_SUCCESS;
+    while ((remaining > 0) && (resp == RESP_SUCCESS)) {
+        chunk.addr = addr;
+        chunk.data = data;
+
+        u64 size           = 0;
+        unsigned char* ptr = direct_memory_ptr(chunk, size);
+        if (ptr != NULL) {
+            size = min(size, remaining);
+            if (chunk.is_read() && m_dmi_swapped)
+                memcpy_from_words(data, ptr, size);
+            else if (chunk.is_read())
+                memcpy(data, ptr, size);
+            else if (m_dmi_swapped)
+                memcpy_to_words(ptr, data, size);
+            else
+                memcpy(ptr, data, size);
+        } else {
+            size       = min(remaining, (u64)OR1KISS_TRANSFER_CHUNK);
+            chunk.size = size;
+            resp       = transact(chunk);
+        }
+
+        if (chunk.is_write() && (resp == RESP_SUCCESS)) {
+            m_monitor->notify_store(addr, size);
+            for (decode_cache* cache : m_decode_caches)
+                cache->invalidate_block(addr & ~3u, size + (addr & 3u));
+        }
+
+        addr += size;
+        data += size;
+        remaining -= size;
+    }
+
+    req.cycles += chunk.cycles;
+    return resp;
+}
+
 } // namespace or1kiss
@@ -0,0 +1,146 @@
+/******************************************************************************
+ *                                                                            *
+ * Copyright 2018 Jan Henrik Weinstock                                        *
+ *                                                                            *
+ * Licensed under the Apache License, Version 2.0 (the "License");            *
+ * you may not use this file except in compliance with the License.           *
+ * You may obtain a copy of the License at                                    *
+ *                                                                            *
+ *     http://www.apache.org/licenses/LICENSE-2.0                             *
+ *                                                                            *
+ * Unless required by applicable law or agreed to in writing, software        *
+ * distributed under the License is distributed on an "AS IS" BASIS,          *
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.   *
+ * See the License for the specific language governing permissions and        *
+ * limitations under the License.                                             *
+ *                                                                            *
+ ******************************************************************************/
+
+#include "or1kiss/event.h"
+
+namespace or1kiss {
+
+bool event_queue::before(size_t a, size_t b) const {
+    return m_events[m_heap[a]].cycle < m_events[m_heap[b]].cycle;
+}
+
+void event_queue::place(size_t pos, u32 id) {
+    m_heap[pos]      = id;
+    m_events[id].pos = pos;
+}
+
+void event_queue::sift_up(size_t pos) {
+    while (pos > 0) {
+        size_t parent = (pos - 1) / 2;
+        if (!before(pos, parent))
+            break;
+
+        u32 id = m_heap[pos];
+        place(pos, m_heap[parent]);
+        place(parent, id);
+        pos = parent;
+    }
+}
+
+void event_queue::sift_down(size_t pos) {
+    while (true) {
+        size_t child = 2 * pos + 1;
+        if (child >= m_heap.size())
+            break;
+        if (child + 1 < m_heap.size() && before(child + 1, child))
+            child++;
+        if (!before(child, pos))
+            break;
+
+        u32 id = m_heap[pos];
+        place(pos, m_heap[child]);
+        place(child, id);
+        pos = child;
+    }
+}
+
+void event_queue::remove(size_t pos) {
+    u32 id           = m_heap[pos];
+    m_events[id].pos = npos;
+
+    u32 last = m_heap.back();
+    m_heap.pop_back();
+    if (pos == m_heap.size())
+        return;
+
+    place(pos, last);
+    sift_up(pos);
+    sift_down(m_events[last].pos);
+}
+
+event_queue::event_queue(): m_events(), m_heap(), m_free() {
+    /* Nothing to do */
+}
+
+event_queue::~event_queue() {
+    /* Nothing to do */
+}
+
+u32 event_queue::create(const event_handler& handler) {
+    if (!handler)
+        OR1KISS_ERROR("event handler must not be empty");
+
+    event ev = { handler, 0, npos };
+    if (m_free.empty()) {
+        m_events.push_back(ev);
+        return m_events.size() - 1;
+    }
+
+    u32 id = m_free.back();
+    m_free.pop_back();
+    m_events[id] = ev;
+    return id;
+}
+
+void event_queue::destroy(u32 id) {
+    if (id >= m_events.size() || !m_events[id].handler)
+        OR1KISS_ERROR("invalid event id %u", id);
+
+    cancel(id);
+    m_events[id].handler = nullptr;
+    m_free.push_back(id);
+}
+
+void event_queue::schedule(u32 id, u64 cycle) {
+    if (id >= m_events.size() || !m_events[id].handler)
+        OR1KISS_ERROR("invalid event id %u", id);
+
+    event& ev = m_events[id];
+    if (ev.pos == npos) {
+        ev.cycle = cycle;
+        m_heap.push_back(id);
+        ev.pos = m_heap.size() - 1;
+        sift_up(ev.pos);
+    } else if (cycle < ev.cycle) {
+        ev.cycle = cycle;
+        sift_up(ev.pos);
+    } else if (cycle > ev.cycle) {
+        ev.cycle = cycle;
+        sift_down(ev.pos);
+    }
+}
+
+void event_queue::cancel(u32 id) {
+    if (is_scheduled(id))
+        remove(m_events[id].pos);
+}
+
+void event_queue::run(u64 cycle) {
+    // Handlers may reschedule their own or other events, so take each
+    // event off the heap before running its handler.
+    while (!m_heap.empty() && m_events[m_heap[0]].cycle <= cycle) {
+        u32 id = m_heap[0];
+        remove(0);
+
+        // Copy the handler, creating events may move the original
+        event_handler handler = m_events[id].handler;
+        handler(cycle);
+    }
+}
+
+} // namespace or1kiss
@@ -37,6 +37,30 @@ void or1k::execute_orbis32_movhi(instruction* ci) {
     *d     = ci->imm;
 }
 
+void or1k::execute_breakpoint(instruction* ci) {
+    // Every instruction sharing its page offset with a breakpoint ends up
+    // here, since it might be a physical alias. Most of them are not, so
+    // just execute those as decoded.
+    if (!m_breakpoints.count(m_next_pc)) {
+        instruction insn = *ci;
+        (this->*m_decode_table[decode(insn.insn)])(&insn);
+        (this->*insn.exec)(&insn);
+        return;
+    }
+
+    // Stop before the instruction executes, the program counter is
+    // rewound by advance once the current mini-quantum has been left.
+    // Its latency is added after we return and again once it executes for
+    // real, so take it back here. Fetch costs are kept: the icache line is
+    // filled and load-use stalls are cleared, so neither repeats later.
+    m_cycles -= 1 + ci->stall;
+    m_limit  -= ci->stall;
+    m_instructions--;
+    m_breakpoint_hit     = true;
+    m_breakpoint_prev_pc = m_prev_pc;
+    m_break_requested    = true;
+}
+
 void or1k::execute_orbis32_nop(instruction* ci) {
     nop_mode mode = static_cast<nop_mode>(ci->imm);
     switch (mode) {
@@ -44,23 +68,24 @@ void or1k::execute_orbis32_nop(instruction* ci) {
         break;
 
     case NOP_EXIT:
-        std::cout << "(or1kiss) exit(" << *ci->src1 << ")" << std::endl;
+        *m_console << "(or1kiss) exit(" << *ci->src1 << ")" << std::endl;
         m_cycles--; // last cycle is not counted
         m_instructions--;
         m_stop_requested = true;
         break;
 
     case NOP_REPORT:
-        std::cout << "(or1kiss) report(0x" << std::setw(8) << std::setfill('0')
-                  << std::right << std::hex << *ci->src1 << ")" << std::endl;
+        *m_console << "(or1kiss) report(0x" << std::setw(8)
+                   << std::setfill('0') << std::right << std::hex
+                   << *ci->src1 << ")" << std::endl;
         break;
 
     case NOP_PUTC:
-        std::cout << static_cast<char>(*ci->src1) << std::flush;
+        *m_console << static_cast<char>(*ci->src1) << std::flush;
         break;
 
     case NOP_CNT_RESET:
-        std::cout << "(or1kiss) info: statistics reset" << std::endl;
+        *m_console << "(or1kiss) info: statistics reset" << std::endl;
         reset_instructions();
         reset_compiles();
 
@@ -81,16 +106,16 @@ void or1k::execute_orbis32_nop(instruction* ci) {
 
     case NOP_TRACE_ON:
         m_trace_enabled = true;
-        std::cout << "(or1kiss) info: tracing enabled" << std::endl;
+        *m_console << "(or1kiss) info: tracing enabled" << std::endl;
         break;
 
     case NOP_TRACE_OFF:
         m_trace_enabled = false;
-        std::cout << "(or1kiss) info: tracing disabled" << std::endl;
+        *m_console << "(or1kiss) info: tracing disabled" << std::endl;
         break;
 
     case NOP_RANDOM:
-        gpr[11] = rand();
+        gpr[11] = replay_input(REPLAY_RANDOM, rand());
         break;
 
     case NOP_OR1KSIM:
@@ -100,7 +125,8 @@ void or1k::execute_orbis32_nop(instruction* ci) {
         break;
 
     case NOP_SILENT_EXIT:
-        std::cout << "(or1kiss) silent exit(" << *ci->src1 << ")" << std::endl;
+        *m_console << "(or1kiss) silent exit(" << *ci->src1 << ")"
+                   << std::endl;
         m_cycles--; // last cycle is not counted
         m_instructions--;
         m_stop_requested = true;
@@ -110,12 +136,27 @@ void or1k::execute_orbis32_nop(instruction* ci) {
         struct timeval tv;
         gettimeofday(&tv, NULL);
         u64 ms  = tv.tv_sec * 1000ull + tv.tv_usec / 1000ull;
+        ms      = replay_input(REPLAY_HOST_TIME, ms);
         gpr[11] = ms & 0xffffffffull;
         gpr[12] = ms >> 32;
     } break;
 
-    case NOP_PUTS:
-        std::cout << (char*)m_env->get_data_ptr(gpr[3]) << std::flush;
+    case NOP_PUTS: {
+        char* str = (char*)m_env->get_data_ptr(gpr[3]);
+        if (m_env->is_dmi_swapped()) {
+            for (; *word_swizzle(str, 1); str++)
+                *m_console << *word_swizzle(str, 1);
+        } else {
+            *m_console << str;
+        }
+        *m_console << std::flush;
+    } break;
+
+    case NOP_ROI:
+        if (m_roi_enabled) {
+            m_roi_hit        = true;
+            m_stop_requested = true;
+        }
         break;
 
     default:
@@ -127,16 +168,20 @@ void or1k::execute_orbis32_bf(instruction* ci) {
     u32 target = ci->imm + m_next_pc;
     u32 delay  = (m_cpucfg & CPUCFGR_ND) ? 0 : 1;
 
-    if (m_status & SR_F)
+    if (m_status & SR_F) {
         schedule_jump(target, delay);
+        stall(m_branch_penalty);
+    }
 }
 
 void or1k::execute_orbis32_bnf(instruction* ci) {
     u32 target = ci->imm + m_next_pc;
     u32 delay  = (m_cpucfg & CPUCFGR_ND) ? 0 : 1;
 
-    if (!(m_status & SR_F))
+    if (!(m_status & SR_F)) {
         schedule_jump(target, delay);
+        stall(m_branch_penalty);
+    }
 }
 
 void or1k::execute_orbis32_jump_rel(instruction* ci) {
@@ -873,7 +918,8 @@ void or1k::execute_orbis32_csync(instruction* ci) {
 }
 
 void or1k::execute_orbis32_msync(instruction* ci) {
-    // nothing to do
+    if (m_wcb_mask)
+        flush_write_buffer();
 }
 
 void or1k::execute_orbis32_psync(instruction* ci) {
@@ -40,17 +40,27 @@ void gdb::warning(const char* text, ...) {
     fflush(stderr);
 }
 
+response gdb::mem_transfer(request& req) {
+    // Note: gdb expects memory in target byte order. A block transfer gives
+    // us the byte order of the environment, so that only works if it is big
+    // endian. Otherwise we need to have the data converted.
+    if (m_env->get_system_endian() == ENDIAN_BIG)
+        return m_env->transfer_block(req);
+
+    req.set_big_endian();
+    return m_env->convert_and_transact(req);
+}
+
 void gdb::mem_read(u32 phys_addr, void* ptr, unsigned int size) {
     request req;
     req.set_dmem();
     req.set_read();
     req.set_debug();
-    req.set_big_endian();
     req.addr = phys_addr;
     req.data = ptr;
     req.size = size;
 
-    if (m_env->convert_and_transact(req) != RESP_SUCCESS)
+    if (mem_transfer(req) != RESP_SUCCESS)
         OR1KISS_ERROR("cannot read memory at 0x%08" PRIx32 " (%d bytes)",
                       phys_addr, size);
 }
@@ -60,10 +70,9 @@ void gdb::mem_write(u32 phys_addr, void* ptr, unsigned int size) {
     req.set_dmem();
     req.set_write();
     req.set_debug();
-    req.set_big_endian();
     req.set_addr_and_data(phys_addr, ptr, size);
 
-    if (m_env->convert_and_transact(req) != RESP_SUCCESS)
+    if (mem_transfer(req) != RESP_SUCCESS)
         OR1KISS_ERROR("cannot write memory at 0x%08" PRIx32 " (%d bytes)",
                       phys_addr, size);
 }
@@ -336,8 +345,10 @@ void gdb::handle_mem_read(const char* command) {
     if (sscanf(command, "m%x,%x", &addr, &length) != 2)
         OR1KISS_ERROR("error parsing command '%s'\n", command);
 
-    std::stringstream ss;
-    ss << std::hex << std::setfill('0');
+    static const char hexchars[] = "0123456789abcdef";
+
+    std::string response;
+    response.reserve(2 * length);
 
     u8 buffer[OR1KISS_GDB_RDBUF_SIZE];
     while (length > 0) {
@@ -360,13 +371,15 @@ void gdb::handle_mem_read(const char* command) {
         addr += num_bytes;
         length -= num_bytes;
 
-        // Append values to string and convert endianess
-        for (unsigned int i = 0; i < num_bytes; i++)
-            ss << std::setw(2) << (int)buffer[i];
+        // Append values to response string
+        for (unsigned int i = 0; i < num_bytes; i++) {
+            response += hexchars[buffer[i] >> 4];
+            response += hexchars[buffer[i] & 0xf];
+        }
     }
 
     // Send response string
-    m_rsp.send(ss.str());
+    m_rsp.send(response);
 }
 
 void gdb::handle_mem_write(const char* command) {
@@ -399,9 +412,9 @@ void gdb::handle_mem_write(const char* command) {
         if (num_bytes > page_remaining)
             num_bytes = page_remaining;
 
-        // Convert byte values, respect endianess
-        for (unsigned int i = 0; i < num_bytes; i++)
-            buffer[i] = str2int(data++, 2);
+        // Convert byte values, two hex characters each
+        for (unsigned int i = 0; i < num_bytes; i++, data += 2)
+            buffer[i] = char2int(data[0]) << 4 | char2int(data[1]);
 
         // Write buffer to memory
         mem_write(phys_addr, buffer, num_bytes);
@@ -605,6 +618,9 @@ step_result gdb::step(unsigned int& cycles) {
         m_rsp.send("W%02x", m_iss.gpr[3]);
         return STEP_EXIT;
 
+    case STEP_ROI:
+        return STEP_ROI;
+
     case STEP_BREAKPOINT:
         m_mode = GDB_MODE_HALTED;
         m_rsp.send("S%02u", SIGTRAP);
@@ -21,7 +21,12 @@
 namespace or1kiss {
 
 decode_cache::decode_cache(decode_cache_size size):
-    m_size(size), m_mask((1 << size) - 1), m_count(1 << size), m_cache(NULL) {
+    m_size(size),
+    m_mask((1 << size) - 1),
+    m_count(1 << size),
+    m_first(0),
+    m_last(m_count - 1),
+    m_cache(NULL) {
     m_cache = new instruction[m_count];
 
     invalidate_all();
@@ -0,0 +1,41 @@
+/******************************************************************************
+ *                                                                            *
+ * Copyright 2018 Jan Henrik Weinstock                                        *
+ *                                                                            *
+ * Licensed under the Apache License, Version 2.0 (the "License");            *
+ * you may not use this file except in compliance with the License.           *
+ * You may obtain a copy of the License at                                    *
+ *                                                                            *
+ *     http://www.apache.org/licenses/LICENSE-2.0                             *
+ *                                                                            *
+ * Unless required by applicable law or agreed to in writing, software        *
+ * distributed under the License is distributed on an "AS IS" BASIS,          *
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.   *
+ * See the License for the specific language governing permissions and        *
+ * limitations under the License.                                             *
+ *                                                                            *
+ ******************************************************************************/
+
+#include "or1kiss/logfile.h"
+
+namespace or1kiss {
+
+bool write_logfile_header(FILE* file, const char* magic, u32 version) {
+    logfile_header hdr;
+    memset(&hdr, 0, sizeof(hdr));
+    memcpy(hdr.magic, magic, sizeof(hdr.magic));
+    hdr.version = version;
+    return fwrite(&hdr, sizeof(hdr), 1, file) == 1;
+}
+
+bool read_logfile_header(FILE* file, const char* magic, u32& version) {
+    logfile_header hdr;
+    if (fread(&hdr, sizeof(hdr), 1, file) != 1 ||
+        memcmp(hdr.magic, magic, sizeof(hdr.magic)))
+        return false;
+
+    version = hdr.version;
+    return true;
+}
+
+} // namespace or1kiss
@@ -0,0 +1,205 @@
+/******************************************************************************
+ *                                                                            *
+ * Copyright 2018 Jan Henrik Weinstock                                        *
+ *                                                                            *
+ * Licensed under the Apache License, Version 2.0 (the "License");            *
+ * you may not use this file except in compliance with the License.           *
+ * You may obtain a copy of the License at                                    *
+ *                                                                            *
+ *     http://www.apache.org/licenses/LICENSE-2.0                             *
+ *                                                                            *
+ * Unless required by applicable law or agreed to in writing, software        *
+ * distributed under the License is distributed on an "AS IS" BASIS,          *
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.   *
+ * See the License for the specific language governing permissions and        *
+ * limitations under the License.                                             *
+ *                                                                            *
+ ******************************************************************************/
+
+#include "or1kiss/memtrace.h"
+
+#ifdef OR1KISS_HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+namespace or1kiss {
+
+static u32 zigzag_encode(u32 delta) {
+    return (delta << 1) ^ (u32)((s32)delta >> 31);
+}
+
+static u32 zigzag_decode(u32 val) {
+    return (val >> 1) ^ (0u - (val & 1));
+}
+
+memtrace_writer::memtrace_writer(const string& filename, bool compress):
+    m_file(NULL),
+    m_compress(compress),
+    m_cycle(0),
+    m_addr(0),
+    m_records(0),
+    m_block(),
+    m_buffer() {
+#ifndef OR1KISS_HAVE_ZLIB
+    m_compress = false;
+#endif
+
+    m_file = fopen(filename.c_str(), "wb");
+    if (m_file == NULL)
+        OR1KISS_ERROR("cannot open memory trace '%s': %s", filename.c_str(),
+                      strerror(errno));
+
+    if (!write_logfile_header(m_file, OR1KISS_MEMTRACE_MAGIC,
+                              OR1KISS_MEMTRACE_VERSION))
+        OR1KISS_ERROR("error writing memory trace: %s", strerror(errno));
+
+    m_block.reserve(OR1KISS_MEMTRACE_BLOCK + 32);
+}
+
+memtrace_writer::~memtrace_writer() {
+    flush();
+    fclose(m_file);
+}
+
+void memtrace_writer::record(const memtrace_record& rec) {
+    u8 flags = ffs32(rec.size) - 1;
+    if (rec.write)
+        flags |= MEMTRACE_WRITE;
+    if (rec.excl)
+        flags |= MEMTRACE_EXCL;
+    if (rec.super)
+        flags |= MEMTRACE_SUPER;
+
+    m_block.push_back(flags);
+    put_varint(m_block, rec.cycle - m_cycle);
+    put_varint(m_block, zigzag_encode(rec.addr - m_addr));
+    put_varint(m_block, rec.value);
+
+    m_cycle = rec.cycle;
+    m_addr  = rec.addr;
+    m_records++;
+
+    if (m_block.size() >= OR1KISS_MEMTRACE_BLOCK)
+        flush_block();
+}
+
+void memtrace_writer::flush_block() {
+    u32 sizes[2] = { (u32)m_block.size(), (u32)m_block.size() };
+    const u8* data = m_block.data();
+
+#ifdef OR1KISS_HAVE_ZLIB
+    // Only keep the compressed block if it actually turned out smaller
+    if (m_compress) {
+        uLongf size = compressBound(m_block.size());
+        m_buffer.resize(size);
+        if (compress2(m_buffer.data(), &size, m_block.data(),
+                      m_block.size(), Z_BEST_SPEED) == Z_OK &&
+            size < m_block.size()) {
+            sizes[1] = size;
+            data     = m_buffer.data();
+        }
+    }
+#endif
+
+    if (fwrite(sizes, sizeof(sizes), 1, m_file) != 1 ||
+        fwrite(data, sizes[1], 1, m_file) != 1)
+        OR1KISS_ERROR("error writing memory trace: %s", strerror(errno));
+
+    // Blocks are decoded independently, so restart delta encoding
+    m_block.clear();
+    m_cycle = 0;
+    m_addr  = 0;
+}
+
+void memtrace_writer::flush() {
+    if (!m_block.empty())
+        flush_block();
+    fflush(m_file);
+}
+
+memtrace_reader::memtrace_reader(const string& filename):
+    m_file(NULL),
+    m_cycle(0),
+    m_addr(0),
+    m_pos(0),
+    m_block(),
+    m_buffer() {
+    m_file = fopen(filename.c_str(), "rb");
+    if (m_file == NULL)
+        OR1KISS_ERROR("cannot open memory trace '%s': %s", filename.c_str(),
+                      strerror(errno));
+
+    u32 version;
+    if (!read_logfile_header(m_file, OR1KISS_MEMTRACE_MAGIC, version))
+        OR1KISS_ERROR("'%s' is not a memory trace", filename.c_str());
+    if (version != OR1KISS_MEMTRACE_VERSION)
+        OR1KISS_ERROR("unsupported memory trace version %u", version);
+}
+
+memtrace_reader::~memtrace_reader() {
+    fclose(m_file);
+}
+
+bool memtrace_reader::next_block() {
+    u32 sizes[2];
+    if (fread(sizes, sizeof(sizes), 1, m_file) != 1)
+        return false;
+
+    m_block.resize(sizes[0]);
+    m_pos   = 0;
+    m_cycle = 0;
+    m_addr  = 0;
+
+    if (sizes[0] == sizes[1]) {
+        if (fread(m_block.data(), sizes[0], 1, m_file) != 1)
+            OR1KISS_ERROR("truncated memory trace");
+        return true;
+    }
+
+#ifdef OR1KISS_HAVE_ZLIB
+    m_buffer.resize(sizes[1]);
+    if (fread(m_buffer.data(), sizes[1], 1, m_file) != 1)
+        OR1KISS_ERROR("truncated memory trace");
+
+    uLongf size = sizes[0];
+    if (uncompress(m_block.data(), &size, m_buffer.data(), sizes[1]) !=
+            Z_OK ||
+        size != sizes[0])
+        OR1KISS_ERROR("corrupt memory trace block");
+
+    return true;
+#else
+    OR1KISS_ERROR("compressed memory traces require zlib");
+#endif
+}
+
+bool memtrace_reader::next(memtrace_record& rec) {
+    while (m_pos >= m_block.size()) {
+        if (!next_block())
+            return false;
+    }
+
+    u8 flags = m_block[m_pos++];
+    auto next_byte = [this]() -> int {
+        return m_pos < m_block.size() ? m_block[m_pos++] : EOF;
+    };
+
+    u64 cycles, delta, value;
+    if (!get_varint(next_byte, cycles) || !get_varint(next_byte, delta) ||
+        !get_varint(next_byte, value))
+        OR1KISS_ERROR("corrupt memory trace record");
+
+    m_cycle += cycles;
+    m_addr += zigzag_decode(delta);
+
+    rec.cycle = m_cycle;
+    rec.addr  = m_addr;
+    rec.size  = 1u << (flags & MEMTRACE_SIZE);
+    rec.value = value;
+    rec.write = flags & MEMTRACE_WRITE;
+    rec.excl  = flags & MEMTRACE_EXCL;
+    rec.super = flags & MEMTRACE_SUPER;
+    return true;
+}
+
+} // namespace or1kiss
@@ -51,6 +51,56 @@ int mmu::find_empty_way(int set) const {
     return select;
 }
 
+u32* mmu::find_entry(u32 addr) {
+    // Regular 8KB pages are indexed by their page number. Software reloads
+    // usually index large pages the same way, so check those here, too.
+    u32 set = OR1KISS_PAGE_NUMBER(addr) & m_set_mask;
+    for (unsigned int way = 0; way < m_num_ways; way++) {
+        u32* match = m_tlb + OR1KISS_TLB_MR(way, set);
+        if (!(*match & MMUM_V))
+            continue;
+        if ((*match & MMUM_PL1) ? OR1KISS_LARGE_PAGE_COMPARE(addr, *match)
+                                : OR1KISS_PAGE_COMPARE(addr, *match))
+            return match;
+    }
+
+    // The table walker indexes large pages by their 16MB page number
+    set = OR1KISS_LARGE_PAGE_NUMBER(addr) & m_set_mask;
+    for (unsigned int way = 0; way < m_num_ways; way++) {
+        u32* match = m_tlb + OR1KISS_TLB_MR(way, set);
+        if (((*match & (MMUM_V | MMUM_PL1)) == (MMUM_V | MMUM_PL1)) &&
+            OR1KISS_LARGE_PAGE_COMPARE(addr, *match))
+            return match;
+    }
+
+    return NULL;
+}
+
+bool mmu::read_pte(const request& req, u32 addr, u32& pte, u64& cycles) {
+    // Page tables in DMI memory are read directly, which saves building a
+    // request and sending it through convert_and_transact at every level.
+    unsigned char* ptr = m_env->get_data_ptr(addr);
+    if ((ptr != NULL) && (m_env->get_data_ptr(addr + 3) != NULL)) {
+        memcpy(&pte, ptr, sizeof(pte));
+        if (!m_env->is_dmi_swapped() &&
+            (m_env->get_system_endian() != host_endian()))
+            pte = byte_swap(pte);
+        cycles += m_env->get_data_cycles();
+        return true;
+    }
+
+    request mmureq(req);
+    mmureq.set_host_endian();
+    mmureq.set_dmem();
+    mmureq.set_read();
+    mmureq.set_addr_and_data(addr, pte);
+    mmureq.cycles = 0;
+
+    response resp = m_env->convert_and_transact(mmureq);
+    cycles += mmureq.cycles;
+    return resp == RESP_SUCCESS;
+}
+
 mmu::mmu(u32 config, env* e):
     m_cfg(config),
     m_ctrl(0),
@@ -59,6 +109,7 @@ mmu::mmu(u32 config, env* e):
     m_num_ways(1 + bits32(config, 1, 0)),
     m_set_mask(m_num_sets - 1),
     m_tlb(),
+    m_large_pages(false),
     m_env(e) {
     // Check that we have a busport if user wants hardware
     // TLB refill enabled
@@ -120,7 +171,16 @@ void mmu::flush_tlb_entry(u32 ea) {
 
     for (unsigned int way = 0; way < m_num_ways; way++) {
         u32* match = m_tlb + OR1KISS_TLB_MR(way, set);
-        if ((OR1KISS_PAGE_COMPARE(vpg, *match)))
+        if ((*match & MMUM_PL1) ? OR1KISS_LARGE_PAGE_COMPARE(vpg, *match)
+                                : OR1KISS_PAGE_COMPARE(vpg, *match))
+            *match &= ~MMUM_V;
+    }
+
+    // Also drop a large page the table walker put into its own set
+    set = OR1KISS_LARGE_PAGE_NUMBER(ea) & m_set_mask;
+    for (unsigned int way = 0; way < m_num_ways; way++) {
+        u32* match = m_tlb + OR1KISS_TLB_MR(way, set);
+        if ((*match & MMUM_PL1) && OR1KISS_LARGE_PAGE_COMPARE(ea, *match))
             *match &= ~MMUM_V;
     }
 }
@@ -140,37 +200,35 @@ mmu_result mmu::translate(request& req) {
     }
 
     // Look for matching entry in TLB
-    for (unsigned int way = 0; way < m_num_ways; way++) {
-        u32* match = m_tlb + OR1KISS_TLB_MR(way, set);
-        u32* trans = m_tlb + OR1KISS_TLB_TR(way, set);
-        if ((*match & MMUM_V) && (OR1KISS_PAGE_COMPARE(vpg, *match))) {
-            if (!req.is_debug()) {
-                // Check access rights
-                if (!(*trans & access_mask(req)))
-                    return MMU_PAGE_FAULT;
-
-                // Update access_mask and dirty flags
-                *trans |= MMUPTE_A;
-                if (req.is_write())
-                    *trans |= MMUPTE_D;
-
-                // Update LRU
-                *match &= ~MMUM_LRU3;
-            }
+    u32* match = find_entry(req.addr);
+    if (match != NULL) {
+        u32* trans = match + OR1KISS_TLB_MAX_SETS;
+        if (!req.is_debug()) {
+            // Check access rights
+            if (!(*trans & access_mask(req)))
+                return MMU_PAGE_FAULT;
+
+            // Update access_mask and dirty flags
+            *trans |= MMUPTE_A;
+            if (req.is_write())
+                *trans |= MMUPTE_D;
+
+            // Update LRU
+            *match &= ~MMUM_LRU3;
+        }
 
-            // Access rights okay, translate address and return
-            u32 ppg  = OR1KISS_PAGE_ALIGN(*trans);
-            u32 off  = OR1KISS_PAGE_OFFSET(req.addr);
-            req.addr = ppg | off;
+        // Access rights okay, translate address and return
+        u32 mask = (*match & MMUM_PL1) ? OR1KISS_LARGE_PAGE_MASK
+                                       : OR1KISS_PAGE_MASK;
+        req.addr = (*trans & ~mask) | (req.addr & mask);
 
-            // Sync request flags to page flags
-            req.set_cache_coherent(*trans & MMUPTE_CC);
-            req.set_cache_inhibit(*trans & MMUPTE_CI);
-            req.set_cache_writeback(*trans & MMUPTE_WBC);
-            req.set_weakly_ordered(*trans & MMUPTE_WOM);
+        // Sync request flags to page flags
+        req.set_cache_coherent(*trans & MMUPTE_CC);
+        req.set_cache_inhibit(*trans & MMUPTE_CI);
+        req.set_cache_writeback(*trans & MMUPTE_WBC);
+        req.set_weakly_ordered(*trans & MMUPTE_WOM);
 
-            return MMU_OKAY;
-        }
+        return MMU_OKAY;
     }
 
     // Nothing found in TLB, if HW reload is disabled and we are not
@@ -189,31 +247,34 @@ mmu_result mmu::translate(request& req) {
     if (page_directory == 0)
         return MMU_TLB_MISS;
 
-    request mmureq(req);
-    mmureq.set_host_endian();
-    mmureq.set_dmem();
-    mmureq.set_read();
-    mmureq.cycles = 0;
+    u64 cycles = 0;
 
     // Get the first page table entry from the L1 page directory. Its
     // base address is stored in the control register.
-    mmureq.set_addr_and_data(page_directory + (pl1idx << 2), pte1);
-    if (m_env->convert_and_transact(mmureq) != RESP_SUCCESS)
+    if (!read_pte(req, page_directory + (pl1idx << 2), pte1, cycles))
         return MMU_TLB_MISS;
 
     if (!pte1)
         return MMU_TLB_MISS; // MMU_PAGE_FAULT;
 
-    u32 page_table = OR1KISS_PAGE_ALIGN(pte1);
-    mmureq.set_addr_and_data(page_table + (pl2idx << 2), pte2);
-    if (m_env->convert_and_transact(mmureq) != RESP_SUCCESS)
-        return MMU_TLB_MISS;
-
-    if (!pte2)
-        return MMU_TLB_MISS; // MMU_PAGE_FAULT;
+    // An L1 entry with the L bit set maps a large page by itself, there is
+    // no L2 page table to look at in that case.
+    bool large = m_large_pages && (pte1 & MMUPTE_L);
+    if (large) {
+        pte2 = pte1;
+        vpg  = OR1KISS_LARGE_PAGE_ALIGN(req.addr) | MMUM_PL1;
+        set  = OR1KISS_LARGE_PAGE_NUMBER(req.addr) & m_set_mask;
+    } else {
+        u32 page_table = OR1KISS_PAGE_ALIGN(pte1);
+        if (!read_pte(req, page_table + (pl2idx << 2), pte2, cycles))
+            return MMU_TLB_MISS;
+
+        if (!pte2)
+            return MMU_TLB_MISS; // MMU_PAGE_FAULT;
+    }
 
     // Need to put the entry also into TLB
-    u32 match = vpg | MMUM_LRU0 | MMUM_V;
+    u32 entry = vpg | MMUM_LRU0 | MMUM_V;
     u32 trans = pte2 | MMUPTE_CC;
 
     // Linux uses bit 10 to mark a page executable (see asm/pgtable.h). So
@@ -231,17 +292,21 @@ mmu_result mmu::translate(request& req) {
         trans |= MMUPTE_D;
 
     // Finish address translation
-    u32 ppg  = OR1KISS_PAGE_ALIGN(trans);
-    u32 off  = OR1KISS_PAGE_OFFSET(req.addr);
-    req.addr = ppg | off;
+    u32 mask = large ? OR1KISS_LARGE_PAGE_MASK : OR1KISS_PAGE_MASK;
+    req.addr = (trans & ~mask) | (req.addr & mask);
+
+    req.set_cache_coherent(trans & MMUPTE_CC);
+    req.set_cache_inhibit(trans & MMUPTE_CI);
+    req.set_cache_writeback(trans & MMUPTE_WBC);
+    req.set_weakly_ordered(trans & MMUPTE_WOM);
 
     if (!req.is_debug()) {
         // Account for the extra lookup time
-        req.cycles += mmureq.cycles;
+        req.cycles += cycles;
 
         // Find an empty location and store in TLB
         int way                         = find_empty_way(set);
-        m_tlb[OR1KISS_TLB_MR(way, set)] = match;
+        m_tlb[OR1KISS_TLB_MR(way, set)] = entry;
         m_tlb[OR1KISS_TLB_TR(way, set)] = trans;
     }
 
@@ -249,4 +314,22 @@ mmu_result mmu::translate(request& req) {
     return MMU_OKAY;
 }
 
+void mmu::save_state(ostream& os) const {
+    serialize(os, m_cfg);
+    serialize(os, m_ctrl);
+    serialize(os, m_prot);
+    serialize(os, m_tlb);
+}
+
+void mmu::restore_state(istream& is) {
+    u32 cfg = 0;
+    deserialize(is, cfg);
+    if (is && (cfg != m_cfg))
+        OR1KISS_ERROR("MMU configuration mismatch (0x%08x)", cfg);
+
+    deserialize(is, m_ctrl);
+    deserialize(is, m_prot);
+    deserialize(is, m_tlb);
+}
+
 } // namespace or1kiss
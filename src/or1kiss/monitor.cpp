@@ -0,0 +1,91 @@
+/******************************************************************************
+ *                                                                            *
+ * Copyright 2018 Jan Henrik Weinstock                                        *
+ *                                                                            *
+ * Licensed under the Apache License, Version 2.0 (the "License");            *
+ * you may not use this file except in compliance with the License.           *
+ * You may obtain a copy of the License at                                    *
+ *                                                                            *
+ *     http://www.apache.org/licenses/LICENSE-2.0                             *
+ *                                                                            *
+ * Unless required by applicable law or agreed to in writing, software        *
+ * distributed under the License is distributed on an "AS IS" BASIS,          *
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.   *
+ * See the License for the specific language governing permissions and        *
+ * limitations under the License.                                             *
+ *                                                                            *
+ ******************************************************************************/
+
+#include "or1kiss/monitor.h"
+
+namespace or1kiss {
+
+void monitor::invalidate(u32 core, u32 addr) {
+    // Only drop the reservation if nobody else changed it in the meantime
+    if (m_addr[core].compare_exchange_strong(addr, OR1KISS_MONITOR_INVALID))
+        m_active--;
+}
+
+monitor::monitor(): m_addr(), m_data(), m_active(0), m_numcores(0) {
+    for (u32 core = 0; core < OR1KISS_MONITOR_CORES; core++)
+        m_addr[core] = OR1KISS_MONITOR_INVALID;
+}
+
+monitor::~monitor() {
+    /* Nothing to do */
+}
+
+void monitor::reserve(u32 core, u32 addr, u32 data) {
+    if (core >= OR1KISS_MONITOR_CORES)
+        OR1KISS_ERROR("core id %u exceeds monitor capacity", core);
+
+    u32 cores = m_numcores.load();
+    while ((core >= cores) &&
+           !m_numcores.compare_exchange_weak(cores, core + 1)) {
+        /* retry */
+    }
+
+    m_data[core] = data;
+    if (m_addr[core].exchange(granule(addr)) == OR1KISS_MONITOR_INVALID)
+        m_active++;
+}
+
+void monitor::clear(u32 core) {
+    if (core >= OR1KISS_MONITOR_CORES)
+        return;
+
+    if (m_addr[core].exchange(OR1KISS_MONITOR_INVALID) !=
+        OR1KISS_MONITOR_INVALID)
+        m_active--;
+}
+
+void monitor::clear_all() {
+    for (u32 core = 0; core < OR1KISS_MONITOR_CORES; core++)
+        clear(core);
+}
+
+bool monitor::store_conditional(u32 core, u32 addr, void* ptr, u32 data) {
+    if (core >= OR1KISS_MONITOR_CORES)
+        return false;
+
+    // Claim our own reservation first; if another core has written to the
+    // granule since l.lwa, it is already gone and l.swa fails.
+    u32 resv = granule(addr);
+    if (!m_addr[core].compare_exchange_strong(resv, OR1KISS_MONITOR_INVALID)) {
+        clear(core); // l.swa to another address also drops the reservation
+        return false;
+    }
+
+    m_active--;
+
+    // The memory update itself is a compare-and-swap against the value
+    // loaded by l.lwa, which catches stores that raced with the claim.
+    if (!cas(ptr, m_data[core], data))
+        return false;
+
+    // Success: other cores holding the same granule lose their reservation
+    notify_store(addr, sizeof(data));
+    return true;
+}
+
+} // namespace or1kiss
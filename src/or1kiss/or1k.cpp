@@ -21,14 +21,13 @@
 namespace or1kiss {
 
 step_result or1k::advance(unsigned int cycles) {
-    // Start simulation for a quantum of n cycles. We assume every
-    // instruction takes one cycle to complete. If an instruction takes
-    // longer, we might overshoot this limit.
+    // Start simulation for a quantum of n cycles. Instruction latencies,
+    // branch penalties and cache misses are added as they occur, so the
+    // last instruction might overshoot this limit.
     m_limit = m_cycles + cycles;
 
     // Check for any unmasked interrupts
-    if (unlikely(m_pic_sr & m_pic_mr))
-        exception(EX_EXTERNAL);
+    check_interrupts();
 
     // Check if we can sleep: doze() will advance the cycle counter until
     // the first cycle we are not allowed to sleep anymore. Therefore it is
@@ -36,14 +35,18 @@ step_result or1k::advance(unsigned int cycles) {
     // limit and the loop below will not be entered.
     doze();
 
+    // Take any interrupt that woke us up before executing further
+    check_interrupts();
+
     while (m_cycles < m_limit) {
         m_wp_event.hit    = false;
         m_stop_requested  = false;
         m_break_requested = false;
+        m_roi_hit         = false;
+        m_breakpoint_hit  = false;
 
-        u64 limit = min(m_limit, next_breakpoint());
-        if (m_tick.enabled())
-            limit = min(limit, m_cycles + m_tick.next_tick());
+        // Simulate up to the next timed event, e.g. tick timer expiry
+        u64 limit = min(m_limit, m_events.next());
 
         // This loop is performance critical. Make it as fast as possible.
         while (m_cycles < limit) {
@@ -55,12 +58,15 @@ step_result or1k::advance(unsigned int cycles) {
             // instruction from the instruction cache, otherwise it will
             // fetch it from memory and decode it.
             instruction* insn = fetch();
+            if (unlikely(m_load_dest != NULL))
+                check_load_use(insn);
 
             // Execute instruction, if the previous instruction fetch
             // completed, i.e. it did not produce an exception.
             if (likely(insn != NULL)) {
                 (this->*insn->exec)(insn);
-                if (unlikely(m_trace_enabled))
+                stall(insn->stall);
+                if (unlikely(m_trace_enabled) && !m_breakpoint_hit)
                     do_trace(insn);
             }
 
@@ -72,14 +78,12 @@ step_result or1k::advance(unsigned int cycles) {
             m_prev_pc = m_next_pc;
             m_next_pc = m_next_pc + 4;
 
-            if (unlikely(m_instructions == m_jump_insn)) {
+            if (unlikely(m_instructions == m_jump_insn))
                 m_next_pc = m_jump_target;
-                limit     = min(limit, next_breakpoint());
-            }
 
             // Check if an instruction wanted to exit
             if (unlikely(m_stop_requested))
-                return STEP_EXIT;
+                return m_roi_hit ? STEP_ROI : STEP_EXIT;
 
             // Break quantum (usually on SPR write)
             if (unlikely(m_break_requested))
@@ -89,14 +93,19 @@ step_result or1k::advance(unsigned int cycles) {
                 break;
         }
 
-        // At this point the current mini-quantum has been completed. Since
-        // during a mini quantum we are guaranteed that no timer exceptions
-        // can happen, the timer may be update only afterwards.
-        update_timer();
+        // A breakpoint stops in front of its instruction, so rewind the
+        // program counter to let execution resume there later on.
+        if (unlikely(m_breakpoint_hit)) {
+            m_next_pc = m_prev_pc;
+            m_prev_pc = m_breakpoint_prev_pc;
+        }
+
+        // At this point the current mini-quantum has been completed, run
+        // whatever became due meanwhile, e.g. tick timer expiry.
+        m_events.run(m_cycles);
 
         // Check for interrupts in case we just woke up from sleep.
-        if (unlikely(m_pic_sr & m_pic_mr))
-            exception(EX_EXTERNAL);
+        check_interrupts();
 
         // Check if we dropped out due to a breakpoint or watchpoint
         if (unlikely(breakpoint_hit()))
@@ -115,7 +124,7 @@ void or1k::doze() {
 
     u64 cycles, skip = ~0ull;
     if (m_tick.enabled() && m_tick.irq_enabled())
-        skip = min(m_tick.next_tick(), (u64)m_tick.limit());
+        skip = min(m_tick.next_tick(m_cycles), (u64)m_tick.limit());
 
     if ((cycles = m_env->sleep(skip))) { // try SystemC-sleep first
         m_cycles += cycles;
@@ -123,11 +132,111 @@ void or1k::doze() {
         m_limit += cycles;
         m_pmr &= ~PMR_DME;
     } else { // regular sleep, skip over the quantum but stay asleep
-        skip = min(skip, m_limit - m_cycles);
-        m_cycles += skip;
-        m_sleep_cycles += skip;
-        update_timer();
+        u64 wake = m_cycles + min(skip, m_limit - m_cycles);
+        while (m_cycles < wake) {
+            // Sleep from event to event, so that their handlers run in time
+            u64 until = max(m_cycles, min(wake, m_events.next()));
+            if (unlikely(m_realtime))
+                until = pace_sleep(until);
+            m_sleep_cycles += until - m_cycles;
+            m_cycles = until;
+            m_events.run(m_cycles);
+
+            // Stop sleeping early if an event handler or another thread
+            // raised an interrupt in the meantime
+            if (unlikely(m_pic_mailbox.load(std::memory_order_relaxed) != 0))
+                deliver_interrupts();
+            if ((m_pic_sr & m_pic_mr) || m_tick.irq_pending())
+                break;
+        }
+    }
+}
+
+u64 or1k::idle(u64 cycles) {
+    // Real-time pacing happens while dozing, so it cannot be skipped
+    if (!is_sleeping() || m_realtime)
+        return 0;
+    if (m_pic_mailbox.load(std::memory_order_relaxed) != 0)
+        return 0;
+
+    u64 start = m_cycles, wake = m_cycles + cycles;
+    if (m_tick.enabled() && m_tick.irq_enabled()) {
+        u64 skip = min(m_tick.next_tick(m_cycles), (u64)m_tick.limit());
+        wake = min(wake, m_cycles + skip);
+    }
+
+    // Like doze(), but without a quantum limit and leaving delivery of
+    // interrupts to the next step
+    while (m_cycles < wake) {
+        m_cycles = max(m_cycles, min(wake, m_events.next()));
+        m_events.run(m_cycles);
+
+        if (m_pic_mailbox.load(std::memory_order_relaxed) != 0)
+            break;
+        if ((m_pic_sr & m_pic_mr) || m_tick.irq_pending())
+            break;
     }
+
+    m_sleep_cycles += m_cycles - start;
+    return m_cycles - start;
+}
+
+static u64 host_time_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static void host_sleep_ns(u64 ns) {
+    struct timespec ts;
+    ts.tv_sec  = ns / 1000000000ull;
+    ts.tv_nsec = ns % 1000000000ull;
+    while (nanosleep(&ts, &ts) && errno == EINTR)
+        ; // keep on sleeping for the remaining time
+}
+
+u64 or1k::realtime_deadline(u64 cycle) {
+    // Start over if someone reset the cycle counter
+    if (cycle < m_rt_cycles) {
+        m_rt_cycles = cycle;
+        m_rt_start  = host_time_ns();
+    }
+
+    u64 delta = cycle - m_rt_cycles;
+    return m_rt_start + (u64)((double)delta * 1e9 / m_clock);
+}
+
+void or1k::pace() {
+    // Sleep if simulation is ahead of the host, otherwise record the lag
+    u64 deadline = realtime_deadline(m_cycles);
+    u64 now      = host_time_ns();
+
+    m_rt_checks++;
+    if (now < deadline) {
+        host_sleep_ns(deadline - now);
+    } else {
+        u64 lag = now - deadline;
+        m_rt_behind++;
+        m_rt_lag_sum += lag;
+        m_rt_lag_max = max(m_rt_lag_max, lag);
+    }
+}
+
+u64 or1k::pace_sleep(u64 until) {
+    // Sleep in slices to notice interrupts posted by other threads, e.g.
+    // from an I/O thread. Simulation time then only advances up to the
+    // moment the interrupt arrived.
+    u64 deadline = realtime_deadline(until);
+    for (u64 now = host_time_ns(); now < deadline; now = host_time_ns()) {
+        if (m_pic_mailbox.load(std::memory_order_relaxed)) {
+            u64 done = (u64)((double)(now - m_rt_start) * m_clock / 1e9);
+            return min(until, max(m_cycles, m_rt_cycles + done));
+        }
+
+        host_sleep_ns(min<u64>(deadline - now, OR1KISS_RT_SLICE));
+    }
+
+    return until;
 }
 
 bool or1k::transact(request& req) {
@@ -143,13 +252,15 @@ bool or1k::transact(request& req) {
     // Check if we hit a watchpoint
     if (!req.is_debug() && req.is_dmem()) {
         bool hit = false;
-        if (unlikely(!m_watchpoints_r.empty() && req.is_read())) {
-            for (auto wp : m_watchpoints_r)
+        if (unlikely(!m_watchpoints_r.empty() && req.is_read()) &&
+            m_watchfilter_r.test(req.addr, req.size)) {
+            for (const auto& wp : m_watchpoints_r)
                 hit |= wp.overlaps(req.addr, req.size);
         }
 
-        if (unlikely(!m_watchpoints_w.empty() && req.is_write())) {
-            for (auto wp : m_watchpoints_w)
+        if (unlikely(!m_watchpoints_w.empty() && req.is_write()) &&
+            m_watchfilter_w.test(req.addr, req.size)) {
+            for (const auto& wp : m_watchpoints_w)
                 hit |= wp.overlaps(req.addr, req.size);
         }
 
@@ -189,6 +300,31 @@ bool or1k::transact(request& req) {
         }
     }
 
+    // Model data cache timing, unless the page is cache inhibited
+    if (is_dcache_active() && !req.is_debug() &&
+        !(is_dmmu_active() && req.is_cache_inhibit())) {
+        if (req.is_read())
+            req.cycles += m_dcache.read(req.addr);
+        else
+            m_dcache.write(req.addr);
+    }
+
+    // Weakly ordered stores that miss DMI are posted to the write combining
+    // buffer. Other accesses to the buffered block must not overtake them.
+    if (unlikely(m_wcb_enabled) && !req.is_debug()) {
+        if (is_postable(req)) {
+            if (unlikely(m_memtrace != NULL))
+                record_access(req);
+            return post_write(req);
+        }
+
+        if (m_wcb_mask && (req.is_exclusive() ||
+                           OR1KISS_WCB_ALIGN(req.addr) == m_wcb_addr)) {
+            if (!flush_write_buffer())
+                return false;
+        }
+    }
+
     // Handle exclusive memory access intricacies
     if (req.is_exclusive()) {
         assert(req.size == SIZE_WORD);
@@ -198,8 +334,16 @@ bool or1k::transact(request& req) {
             m_num_excl_write++;
     }
 
-    // Let port convert endianess and send the request
-    switch (m_env->convert_and_transact(req)) {
+    // Let port convert endianess and send the request. Accesses outside of
+    // DMI may reach devices that depend on the host, e.g. console input.
+    response resp;
+    if (unlikely(m_recorder || m_replayer) && !req.is_debug() &&
+        m_env->get_data_ptr(req.addr) == NULL)
+        resp = replay_transact(req);
+    else
+        resp = m_env->convert_and_transact(req);
+
+    switch (resp) {
     case RESP_ERROR:
         exception(EX_DATA_BUS_ERROR, req.addr);
         return false;
@@ -225,8 +369,173 @@ bool or1k::transact(request& req) {
     // to get the data from memory. In case an exception occurs no extra
     // cycle is consumed (ToDo: verify this).
     if (!req.is_debug()) {
+        if (unlikely(m_memtrace != NULL))
+            record_access(req);
+
+        // Remember loaded registers for the load-use hazard check
+        if (m_load_use_penalty && req.is_read())
+            m_load_dest = (u32*)req.data;
+
+        m_cycles += req.cycles;
+        m_limit += req.cycles;
+    }
+
+    return true;
+}
+
+void or1k::record_access(const request& req) {
+    memtrace_record rec;
+    rec.cycle = m_cycles;
+    rec.addr  = req.addr;
+    rec.size  = req.size;
+    rec.write = req.is_write();
+    rec.excl  = req.is_exclusive();
+    rec.super = req.is_supervisor();
+    rec.value = 0;
+
+    // Request data is in request endianess, the trace holds plain values
+    bool swap = req.get_endian() != host_endian();
+    switch (req.size) {
+    case SIZE_BYTE:
+        rec.value = *(u8*)req.data;
+        break;
+
+    case SIZE_HALFWORD:
+        rec.value = *(u16*)req.data;
+        rec.value = swap ? byte_swap((u16)rec.value) : rec.value;
+        break;
+
+    case SIZE_WORD:
+        rec.value = *(u32*)req.data;
+        rec.value = swap ? byte_swap((u32)rec.value) : rec.value;
+        break;
+
+    case SIZE_DOUBLEWORD:
+        rec.value = *(u64*)req.data;
+        rec.value = swap ? byte_swap(rec.value) : rec.value;
+        break;
+
+    default:
+        break;
+    }
+
+    m_memtrace->record(rec);
+}
+
+void or1k::record_input(replay_kind kind, u64 value, u64 cycles,
+                        response resp) {
+    replay_record rec;
+    rec.insn   = m_instructions;
+    rec.cycle  = m_cycles;
+    rec.value  = value;
+    rec.cycles = cycles;
+    rec.resp   = resp;
+    rec.kind   = kind;
+    m_recorder->record(rec);
+}
+
+replay_record or1k::replay_take(replay_kind kind) {
+    replay_record rec = m_replay;
+    if (rec.kind != kind || rec.insn != m_instructions ||
+        rec.cycle != m_cycles)
+        OR1KISS_ERROR("replay diverged at instruction %llu, cycle %llu",
+                      (unsigned long long)m_instructions,
+                      (unsigned long long)m_cycles);
+
+    replay_advance();
+    return rec;
+}
+
+void or1k::replay_advance() {
+    if (!m_replayer->next(m_replay)) {
+        *m_console << "(or1kiss) info: replay finished at instruction "
+                   << m_instructions << std::endl;
+        delete m_replayer;
+        m_replayer = NULL;
+        return;
+    }
+
+    // Interrupts are due at a cycle, other inputs get asked for
+    if (m_replay.kind == REPLAY_IRQ)
+        m_events.schedule(m_replay_event, m_replay.cycle);
+}
+
+u64 or1k::replay_input(replay_kind kind, u64 value) {
+    if (m_replayer != NULL)
+        return replay_take(kind).value;
+    if (m_recorder != NULL)
+        record_input(kind, value);
+    return value;
+}
+
+response or1k::replay_transact(request& req) {
+    if (m_replayer != NULL) {
+        replay_record rec = replay_take(REPLAY_BUS);
+        if (req.is_write()) // devices still get to see writes
+            m_env->convert_and_transact(req);
+        else
+            memcpy(req.data, &rec.value, min<size_t>(req.size, 8));
+        req.cycles = rec.cycles;
+        return (response)rec.resp;
+    }
+
+    response resp = m_env->convert_and_transact(req);
+
+    u64 value = 0;
+    if (req.is_read())
+        memcpy(&value, req.data, min<size_t>(req.size, 8));
+    record_input(REPLAY_BUS, value, req.cycles, resp);
+    return resp;
+}
+
+bool or1k::post_write(const request& req) {
+    u32 block = OR1KISS_WCB_ALIGN(req.addr);
+    if (m_wcb_mask && (block != m_wcb_addr) && !flush_write_buffer())
+        return false;
+
+    // Keep buffered data in system endianess, ready to be sent as is
+    u32 offset = req.addr - block;
+    if ((req.size > 1) && (req.get_endian() != m_env->get_system_endian()))
+        memcpyswp(m_wcb_data + offset, req.data, req.size);
+    else
+        memcpy(m_wcb_data + offset, req.data, req.size);
+
+    m_wcb_addr = block;
+    m_wcb_mask |= ((1u << req.size) - 1) << offset;
+    return true;
+}
+
+bool or1k::drain_write_buffer(u32& addr) {
+    u32 mask   = m_wcb_mask;
+    m_wcb_mask = 0;
+
+    request req;
+    req.set_dmem();
+    req.set_write();
+    req.set_supervisor(is_supervisor());
+    req.set_core_id(m_core_id);
+    req.set_weakly_ordered(true);
+
+    // Send contiguous runs of valid bytes as naturally aligned pieces of up
+    // to eight bytes, so that the environment only sees regular sizes.
+    while (mask) {
+        u32 offset = ffs32(mask) - 1;
+        u32 size   = SIZE_DOUBLEWORD;
+        while ((size > 1) && ((offset & (size - 1)) ||
+                              (~mask >> offset) & ((1u << size) - 1))) {
+            size >>= 1;
+        }
+
+        req.set_addr_and_data(m_wcb_addr + offset, m_wcb_data + offset, size);
+        req.cycles = 0;
+        if (m_env->transfer_block(req) != RESP_SUCCESS) {
+            addr = req.addr;
+            return false;
+        }
+
         m_cycles += req.cycles;
         m_limit += req.cycles;
+        mask &= ~(((1u << size) - 1) << offset);
     }
 
     return true;
@@ -265,6 +574,14 @@ instruction* or1k::fetch() {
         }
     }
 
+    // Model instruction cache timing, unless the page is cache inhibited
+    if (is_icache_active() &&
+        !(is_immu_active() && m_ireq.is_cache_inhibit())) {
+        u32 cost = m_icache.read(m_ireq.addr);
+        m_cycles += cost;
+        m_limit += cost;
+    }
+
     // Lookup instruction in cache first
     instruction& insn = m_decode_cache.lookup(m_ireq.addr);
     if ((insn.addr == m_ireq.addr) && (!is_decode_cache_off())) {
@@ -275,7 +592,9 @@ instruction* or1k::fetch() {
     // Fetch instruction from memory
     unsigned char* pmem = m_env->get_insn_ptr(m_ireq.addr);
     if (pmem) {
-        m_insn = byte_swap(*(u32*)(pmem));
+        m_insn = *(u32*)(pmem);
+        if (!m_env->is_dmi_swapped())
+            m_insn = byte_swap(m_insn);
     } else {
         switch (m_env->convert_and_transact(m_ireq)) {
         case RESP_ERROR:
@@ -309,11 +628,27 @@ instruction* or1k::fetch() {
     memset(&insn, 0, sizeof(insn));
     insn.addr = m_ireq.addr;
     insn.insn = m_insn;
+    m_decode_cache.touch(insn.addr);
 
     auto handler = m_decode_table[code];
     (this->*handler)(&insn);
     m_compiles++;
 
+    // Resolve timing now, so that execution only needs to add it up.
+    // Unconditional jumps are always taken, branches pay when they are.
+    insn.stall = m_latency[code] - 1;
+    if (code == ORBIS32_J || code == ORBIS32_JR || code == ORBIS32_JAL ||
+        code == ORBIS32_JALR)
+        insn.stall += m_branch_penalty;
+
+    // Breakpoints take over the decoded instruction at their address, so
+    // that they do not cost anything until they actually get executed. The
+    // cache is physically indexed and any virtual alias of a breakpoint has
+    // the same page offset, so tag all of those and sort them out later.
+    if (unlikely(!m_breakpoints.empty()) &&
+        m_breakpoint_offsets.count(OR1KISS_PAGE_OFFSET(m_ireq.addr)))
+        insn.exec = &or1k::execute_breakpoint;
+
     // Compilation successful
     return &insn;
 }
@@ -345,6 +680,12 @@ void or1k::exception(unsigned int type, u32 addr) {
     if ((type == EX_TICK_TIMER) && !(m_status & SR_TEE))
         return;
 
+    // Posted writes must complete before entering the exception handler.
+    // If they fail, the exception at hand takes precedence.
+    u32 wcb_addr = 0;
+    if (unlikely(m_wcb_mask) && !drain_write_buffer(wcb_addr))
+        warn("posted write to 0x%08x failed", wcb_addr);
+
     bool is_jump_insn  = (m_instructions == (m_jump_insn - 1));
     bool is_delay_insn = (m_instructions == (m_jump_insn - 0));
 
@@ -430,19 +771,59 @@ void or1k::interrupt_edge(int id, bool set) {
 }
 
 void or1k::interrupt(int id, bool set) {
+    // Defer to the next delivery point, where the recorder picks it up
+    if (unlikely(m_recorder || m_replayer)) {
+        post_interrupt(id, set);
+        return;
+    }
+
     if (m_pic_level)
         interrupt_level(id, set);
     else
         interrupt_edge(id, set);
 }
 
-void or1k::update_timer() {
-    if (m_tick.enabled()) {
-        m_tick.update(m_cycles - m_tick_update);
-        if (m_tick.irq_pending())
-            exception(EX_TICK_TIMER);
+void or1k::post_interrupt(int id, bool set) {
+    // Interrupts come from the replay log instead
+    if (m_replayer != NULL)
+        return;
+
+    // Edge triggered lines ignore clears, posting one would only risk
+    // dropping a pending edge of a short pulse
+    if (!set && !m_pic_level)
+        return;
+
+    // A newer post for the same line replaces an older one
+    const u64 irq_mask = 1ull << id;
+    const u64 keep     = ~(irq_mask | irq_mask << 32);
+    const u64 post     = set ? irq_mask : irq_mask << 32;
+
+    u64 val = m_pic_mailbox.load(std::memory_order_relaxed);
+    while (!m_pic_mailbox.compare_exchange_weak(val, (val & keep) | post,
+                                                std::memory_order_release,
+                                                std::memory_order_relaxed)) {
+        // val has been reloaded, try again
     }
-    m_tick_update = m_cycles;
+}
+
+void or1k::apply_interrupts(u64 post) {
+    m_pic_sr |= (u32)post;
+    if (m_pic_level)
+        m_pic_sr &= ~(u32)(post >> 32);
+}
+
+void or1k::deliver_interrupts() {
+    u64 post = m_pic_mailbox.exchange(0, std::memory_order_acquire);
+    if (unlikely(m_recorder != NULL) && post != 0)
+        record_input(REPLAY_IRQ, post);
+    apply_interrupts(post);
+}
+
+void or1k::schedule_tick() {
+    if (m_tick.running())
+        m_events.schedule(m_tick_event, m_tick.expiry());
+    else
+        m_events.cancel(m_tick_event);
 }
 
 void or1k::vwarn(const char* format, va_list args) const {
@@ -467,36 +848,46 @@ bool or1k::warn(bool condition, const char* format, ...) const {
     return condition;
 }
 
-u64 or1k::next_breakpoint() const {
-    u64 next = 0xffffffffull;
-    for (unsigned int i = m_breakpoints.size(); i != 0; i--) {
-        u64 until = (m_breakpoints[i - 1] - m_next_pc) / 4;
-        next      = min(next, until);
-    }
-
-    return next + m_cycles;
-}
+void watchpoint_filter::rebuild(const vector<watchpoint>& wps) {
+    m_pages.clear();
+    if (wps.empty())
+        return;
 
-bool or1k::breakpoint_hit() const {
-    for (unsigned int i = 0; i < m_breakpoints.size(); i++) {
-        if (m_breakpoints[i] == m_next_pc)
-            return true;
+    m_pages.resize((OR1KISS_PAGE_NUMBER(~0u) + 1) / 64, 0);
+    for (const auto& wp : wps) {
+        // Clamp ranges wrapping past the top of the address space
+        u64 end   = min((u64)wp.addr + max(wp.size, 1u) - 1, (u64)~0u);
+        u32 first = OR1KISS_PAGE_NUMBER(wp.addr);
+        u32 last  = OR1KISS_PAGE_NUMBER((u32)end);
+        for (u32 page = first; page <= last; page++)
+            m_pages[page / 64] |= 1ull << (page % 64);
     }
-
-    return false;
 }
 
 or1k::or1k(env* e, decode_cache_size size):
     m_decode_cache(size),
     m_decode_table(),
+    m_latency(),
+    m_branch_penalty(0),
+    m_load_use_penalty(0),
+    m_load_dest(NULL),
     m_stop_requested(false),
     m_break_requested(false),
+    m_roi_enabled(false),
+    m_roi_hit(false),
     m_instructions(0),
     m_cycles(0),
     m_compiles(0),
     m_limit(0),
     m_sleep_cycles(0),
     m_clock(OR1KISS_CLOCK),
+    m_realtime(false),
+    m_rt_cycles(0),
+    m_rt_start(0),
+    m_rt_checks(0),
+    m_rt_behind(0),
+    m_rt_lag_max(0),
+    m_rt_lag_sum(0),
     m_jump_target(0),
     m_jump_insn(0),
     m_phys_ipg(-1),
@@ -506,8 +897,6 @@ or1k::or1k(env* e, decode_cache_size size):
     m_version(OR1KISS_REG_VERSION),
     m_version2(OR1KISS_CPU_VERSION),
     m_avr(OR1KISS_ARCH_VERSION),
-    m_dccfgr(0),
-    m_iccfgr(0),
     m_unit(UPR_TTP | UPR_PICP | UPR_MP | UPR_UP | UPR_DMP | UPR_IMP | UPR_PMP),
     m_cpucfg(CPUCFGR_OB32S | CPUCFGR_OF32S | CPUCFGR_AECSRP | CPUCFGR_AVRP |
              CPUCFGR_EVBARP),
@@ -528,12 +917,16 @@ or1k::or1k(env* e, decode_cache_size size):
     m_pic_level(true),
     m_pic_mr(OR1KISS_PIC_NMI),
     m_pic_sr(0),
+    m_pic_mailbox(0),
     m_core_id(0),
     m_num_cores(1),
     m_num_excl_read(0),
     m_num_excl_write(0),
     m_num_excl_failed(0),
-    m_tick_update(0),
+    m_events(),
+    m_tick_event(),
+    m_poll_event(),
+    m_replay_event(),
     m_tick(),
     m_dmmu(
         MMUCFG_NTS128 | MMUCFG_NTW4 | MMUCFG_CRI | MMUCFG_HTR | MMUCFG_TEIRI,
@@ -541,17 +934,34 @@ or1k::or1k(env* e, decode_cache_size size):
     m_immu(
         MMUCFG_NTS128 | MMUCFG_NTW4 | MMUCFG_CRI | MMUCFG_HTR | MMUCFG_TEIRI,
         e),
+    m_dcache(),
+    m_icache(),
     m_env(e),
     m_ireq(),
     m_dreq(),
     m_breakpoints(),
+    m_breakpoint_offsets(),
+    m_breakpoint_hit(false),
+    m_breakpoint_prev_pc(0),
     m_watchpoints_r(),
     m_watchpoints_w(),
+    m_watchfilter_r(),
+    m_watchfilter_w(),
     m_wp_event({}),
+    m_wcb_enabled(false),
+    m_wcb_addr(0),
+    m_wcb_mask(0),
+    m_wcb_data(),
     m_trace_enabled(false),
     m_trace_addr(0),
     m_user_trace_stream(NULL),
     m_file_trace_stream(NULL),
+    m_console(&std::cout),
+    m_memtrace(NULL),
+    m_recorder(NULL),
+    m_replayer(NULL),
+    m_replay(),
+    m_snapshot(),
     m_fp_round_mode(0),
     gpr() {
     m_ireq.set_read();
@@ -561,6 +971,10 @@ or1k::or1k(env* e, decode_cache_size size):
 
     m_dreq.set_dmem();
 
+    // Let the environment invalidate instructions it overwrites
+    if (m_env != NULL)
+        m_env->attach(&m_decode_cache);
+
     // Setup decode table
     m_decode_table[ORBIS32_NOP]   = &or1k::decode_orbis32_nop;
     m_decode_table[ORBIS32_MFSPR] = &or1k::decode_orbis32_mfspr;
@@ -701,11 +1115,43 @@ or1k::or1k(env* e, decode_cache_size size):
 
     m_decode_table[ORFPX32_CUST1] = &or1k::decode_na;
     m_decode_table[ORFPX64_CUST1] = &or1k::decode_na;
+
+    // Every instruction takes a single cycle unless configured otherwise
+    std::fill(m_latency, m_latency + NUM_OPCODES, 1);
+
+    // Tick expiry raises the interrupt pending flag, which is taken once
+    // the mini-quantum ends. Polling regularly ends mini-quanta to pick up
+    // posted interrupts in time.
+    m_tick_event = m_events.create([this](u64 cycle) {
+        m_tick.update(m_cycles);
+        schedule_tick();
+    });
+    m_poll_event = m_events.create([this](u64 cycle) {
+        m_events.schedule(m_poll_event, cycle + OR1KISS_PIC_POLL);
+    });
+
+    m_replay_event = m_events.create([this](u64 cycle) {
+        apply_interrupts(replay_take(REPLAY_IRQ).value);
+    });
+
+    m_events.schedule(m_poll_event, OR1KISS_PIC_POLL);
 }
 
 or1k::~or1k() {
+    if (m_env != NULL)
+        m_env->detach(&m_decode_cache);
+
     if (m_file_trace_stream != NULL)
         delete m_file_trace_stream;
+
+    if (m_memtrace != NULL)
+        delete m_memtrace;
+
+    if (m_recorder != NULL)
+        delete m_recorder;
+
+    if (m_replayer != NULL)
+        delete m_replayer;
 }
 
 step_result or1k::step(unsigned int& cycles) {
@@ -713,47 +1159,100 @@ step_result or1k::step(unsigned int& cycles) {
     // case a breakpoint was hit or an exit request (nop 0x1) was issued.
     // Therefore, we report back how many cycles we actually ran.
     step_result sr = advance(cycles);
+    if (m_wcb_mask)
+        flush_write_buffer();
+    if (unlikely(m_realtime))
+        pace();
     cycles += m_cycles - m_limit;
     return sr;
 }
 
 step_result or1k::run(unsigned int quantum) {
     step_result sr = STEP_OK;
-    while (sr == STEP_OK)
+    while (sr == STEP_OK) {
         sr = advance(quantum);
+        if (m_wcb_mask)
+            flush_write_buffer();
+        if (unlikely(m_realtime))
+            pace();
+    }
+
     return sr;
 }
 
 void or1k::insert_breakpoint(u32 addr) {
-    if (!stl_contains(m_breakpoints, addr))
-        m_breakpoints.push_back(addr);
+    m_breakpoints.insert(addr);
+    m_breakpoint_offsets.insert(OR1KISS_PAGE_OFFSET(addr));
+
+    // Tag instructions already decoded at any alias of addr
+    m_decode_cache.retarget(addr, OR1KISS_PAGE_SIZE,
+                            &or1k::execute_breakpoint);
 }
 
 void or1k::remove_breakpoint(u32 addr) {
-    if (stl_contains(m_breakpoints, addr))
-        stl_remove_erase(m_breakpoints, addr);
+    if (!m_breakpoints.erase(addr))
+        return;
+
+    m_breakpoint_offsets.clear();
+    for (u32 bp : m_breakpoints)
+        m_breakpoint_offsets.insert(OR1KISS_PAGE_OFFSET(bp));
+
+    // Aliases of addr may carry the tag, so start over
+    invalidate_decode_cache();
 }
 
 void or1k::insert_watchpoint_r(u32 addr, u32 size) {
     watchpoint wp = { addr, size };
     m_watchpoints_r.push_back(wp);
+    m_watchfilter_r.rebuild(m_watchpoints_r);
 }
 
 void or1k::remove_watchpoint_r(u32 addr, u32 size) {
     stl_remove_erase_if(m_watchpoints_r, [=](const watchpoint& wp) -> bool {
         return wp.overlaps(addr, size);
     });
+    m_watchfilter_r.rebuild(m_watchpoints_r);
 }
 
 void or1k::insert_watchpoint_w(u32 addr, u32 size) {
     watchpoint wp = { addr, size };
     m_watchpoints_w.push_back(wp);
+    m_watchfilter_w.rebuild(m_watchpoints_w);
 }
 
 void or1k::remove_watchpoint_w(u32 addr, u32 size) {
     stl_remove_erase_if(m_watchpoints_w, [=](const watchpoint& wp) -> bool {
         return wp.overlaps(addr, size);
     });
+    m_watchfilter_w.rebuild(m_watchpoints_w);
+}
+
+void or1k::set_realtime(bool set) {
+    // Simulated time starts to run along with host time from here on
+    m_realtime   = set;
+    m_rt_cycles  = m_cycles;
+    m_rt_start   = host_time_ns();
+    m_rt_checks  = 0;
+    m_rt_behind  = 0;
+    m_rt_lag_max = 0;
+    m_rt_lag_sum = 0;
+}
+
+void or1k::set_latency(opcode op, u32 cycles) {
+    if (op == INVALID_OPCODE || op >= NUM_OPCODES)
+        OR1KISS_ERROR("invalid opcode %d", op);
+    if (cycles == 0)
+        OR1KISS_ERROR("latency of %s must be at least one cycle",
+                      opcode_name(op));
+
+    // Latencies get resolved when decoding, so start over
+    m_latency[op] = cycles;
+    invalidate_decode_cache();
+}
+
+void or1k::set_branch_penalty(u32 cycles) {
+    m_branch_penalty = cycles;
+    invalidate_decode_cache();
 }
 
 void or1k::trace(std::ostream& os) {
@@ -771,4 +1270,23 @@ void or1k::trace(const std::string& filename) {
     m_trace_enabled     = true;
 }
 
+void or1k::trace_memory(const string& filename, bool compress) {
+    if (m_memtrace != NULL)
+        OR1KISS_ERROR("memory trace already specified");
+    m_memtrace = new memtrace_writer(filename, compress);
+}
+
+void or1k::record_inputs(const string& filename) {
+    if (m_recorder != NULL || m_replayer != NULL)
+        OR1KISS_ERROR("input recording or replay already specified");
+    m_recorder = new replay_writer(filename);
+}
+
+void or1k::replay_inputs(const string& filename) {
+    if (m_recorder != NULL || m_replayer != NULL)
+        OR1KISS_ERROR("input recording or replay already specified");
+    m_replayer = new replay_reader(filename);
+    replay_advance();
+}
+
 } // namespace or1kiss
@@ -0,0 +1,130 @@
+/******************************************************************************
+ *                                                                            *
+ * Copyright 2018 Jan Henrik Weinstock                                        *
+ *                                                                            *
+ * Licensed under the Apache License, Version 2.0 (the "License");            *
+ * you may not use this file except in compliance with the License.           *
+ * You may obtain a copy of the License at                                    *
+ *                                                                            *
+ *     http://www.apache.org/licenses/LICENSE-2.0                             *
+ *                                                                            *
+ * Unless required by applicable law or agreed to in writing, software        *
+ * distributed under the License is distributed on an "AS IS" BASIS,          *
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.   *
+ * See the License for the specific language governing permissions and        *
+ * limitations under the License.                                             *
+ *                                                                            *
+ ******************************************************************************/
+
+#include "or1kiss/replay.h"
+
+namespace or1kiss {
+
+replay_writer::replay_writer(const string& filename):
+    m_file(NULL),
+    m_insn(0),
+    m_cycle(0),
+    m_records(0),
+    m_buffer() {
+    m_file = fopen(filename.c_str(), "wb");
+    if (m_file == NULL)
+        OR1KISS_ERROR("cannot open replay log '%s': %s", filename.c_str(),
+                      strerror(errno));
+
+    if (!write_logfile_header(m_file, OR1KISS_REPLAY_MAGIC,
+                              OR1KISS_REPLAY_VERSION))
+        OR1KISS_ERROR("error writing replay log: %s", strerror(errno));
+
+    m_buffer.reserve(OR1KISS_REPLAY_BUFFER + 64);
+}
+
+replay_writer::~replay_writer() {
+    flush();
+    fclose(m_file);
+}
+
+void replay_writer::record(const replay_record& rec) {
+    u8 flags = rec.kind & REPLAY_KIND;
+    if (rec.kind == REPLAY_BUS)
+        flags |= (rec.resp << 4) & REPLAY_RESP;
+
+    // Counters may get reset, deltas then simply wrap around
+    m_buffer.push_back(flags);
+    put_varint(m_buffer, rec.insn - m_insn);
+    put_varint(m_buffer, rec.cycle - m_cycle);
+    put_varint(m_buffer, rec.value);
+    if (rec.kind == REPLAY_BUS)
+        put_varint(m_buffer, rec.cycles);
+
+    m_insn  = rec.insn;
+    m_cycle = rec.cycle;
+    m_records++;
+
+    if (m_buffer.size() >= OR1KISS_REPLAY_BUFFER)
+        flush();
+}
+
+void replay_writer::flush() {
+    if (!m_buffer.empty() &&
+        fwrite(m_buffer.data(), m_buffer.size(), 1, m_file) != 1)
+        OR1KISS_ERROR("error writing replay log: %s", strerror(errno));
+
+    m_buffer.clear();
+    fflush(m_file);
+}
+
+replay_reader::replay_reader(const string& filename):
+    m_file(NULL),
+    m_insn(0),
+    m_cycle(0) {
+    m_file = fopen(filename.c_str(), "rb");
+    if (m_file == NULL)
+        OR1KISS_ERROR("cannot open replay log '%s': %s", filename.c_str(),
+                      strerror(errno));
+
+    u32 version;
+    if (!read_logfile_header(m_file, OR1KISS_REPLAY_MAGIC, version))
+        OR1KISS_ERROR("'%s' is not a replay log", filename.c_str());
+    if (version != OR1KISS_REPLAY_VERSION)
+        OR1KISS_ERROR("unsupported replay log version %u", version);
+}
+
+replay_reader::~replay_reader() {
+    fclose(m_file);
+}
+
+bool replay_reader::next(replay_record& rec) {
+    int flags = getc(m_file);
+    if (flags == EOF)
+        return false;
+
+    auto next_byte = [this]() -> int { return getc(m_file); };
+
+    u64 insn, cycle;
+    if (!get_varint(next_byte, insn) || !get_varint(next_byte, cycle) ||
+        !get_varint(next_byte, rec.value))
+        OR1KISS_ERROR("corrupt replay log record");
+
+    rec.kind   = (replay_kind)(flags & REPLAY_KIND);
+    rec.resp   = 0;
+    rec.cycles = 0;
+    if (rec.kind > REPLAY_BUS)
+        OR1KISS_ERROR("corrupt replay log record");
+
+    if (rec.kind == REPLAY_BUS) {
+        if (!get_varint(next_byte, rec.cycles))
+            OR1KISS_ERROR("corrupt replay log record");
+        rec.resp = (flags & REPLAY_RESP) >> 4;
+        if (rec.resp & 2) // sign extend
+            rec.resp -= 4;
+    }
+
+    m_insn += insn;
+    m_cycle += cycle;
+
+    rec.insn  = m_insn;
+    rec.cycle = m_cycle;
+    return true;
+}
+
+} // namespace or1kiss
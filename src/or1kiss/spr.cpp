@@ -173,13 +173,14 @@ u32 or1k::get_spr(u32 reg, bool debug) const {
     case SPR_AVR:
         return m_avr;
     case SPR_UPR:
-        return m_unit;
+        return m_unit | (m_dcache.is_enabled() ? UPR_DCP : 0) |
+               (m_icache.is_enabled() ? UPR_ICP : 0);
     case SPR_CPUCFGR:
         return m_cpucfg;
     case SPR_DCCFGR:
-        return m_dccfgr;
+        return m_dcache.get_cfgr();
     case SPR_ICCFGR:
-        return m_iccfgr;
+        return m_icache.get_cfgr();
     case SPR_DMMUCFGR:
         return m_dmmu.get_cfgr();
     case SPR_IMMUCFGR:
@@ -253,13 +254,13 @@ u32 or1k::get_spr(u32 reg, bool debug) const {
     case SPR_PICMR:
         return m_pic_mr;
     case SPR_PICSR:
-        return m_pic_sr;
+        return get_pic_sr();
 
     /* Tick Timer group */
     case SPR_TTMR:
         return m_tick.get_ttmr();
     case SPR_TTCR:
-        return m_tick.get_ttcr();
+        return m_tick.get_ttcr(m_cycles);
 
     default:
         break;
@@ -381,10 +382,12 @@ void or1k::set_spr(u32 reg, u32 val, bool debug) {
     /* Data Cache group */
     case SPR_DCBPR:
         return; /* prefetch */
-    case SPR_DCBFR:
-        return; /* flush */
+    case SPR_DCBFR: /* write-through, flush is just invalidate */
+        m_dcache.invalidate(val);
+        return;
     case SPR_DCBIR:
-        return; /* invalidate */
+        m_dcache.invalidate(val);
+        return;
     case SPR_DCBWR:
         return; /* write back */
     case SPR_DCBLR:
@@ -394,6 +397,7 @@ void or1k::set_spr(u32 reg, u32 val, bool debug) {
     case SPR_ICBPR:
         return; /* prefetch */
     case SPR_ICBIR:
+        m_icache.invalidate(val);
         m_decode_cache.invalidate_block(val, 32);
         return;
     case SPR_ICBLR:
@@ -418,16 +422,22 @@ void or1k::set_spr(u32 reg, u32 val, bool debug) {
         m_pic_mr = val | OR1KISS_PIC_NMI;
         return;
     case SPR_PICSR:
+        // Recording only delivers at mini-quantum boundaries, where replay
+        // can inject the same interrupts again
+        if (m_recorder == NULL)
+            deliver_interrupts();
         if (!m_pic_level)
             m_pic_sr &= ~val;
         return;
 
     /* Tick Timer group */
     case SPR_TTMR:
-        m_tick.set_ttmr(val);
+        m_tick.set_ttmr(val, m_cycles);
+        schedule_tick();
         return;
     case SPR_TTCR:
-        m_tick.set_ttcr(val);
+        m_tick.set_ttcr(val, m_cycles);
+        schedule_tick();
         return;
 
     default:
@@ -0,0 +1,163 @@
+/******************************************************************************
+ *                                                                            *
+ * Copyright 2018 Jan Henrik Weinstock                                        *
+ *                                                                            *
+ * Licensed under the Apache License, Version 2.0 (the "License");            *
+ * you may not use this file except in compliance with the License.           *
+ * You may obtain a copy of the License at                                    *
+ *                                                                            *
+ *     http://www.apache.org/licenses/LICENSE-2.0                             *
+ *                                                                            *
+ * Unless required by applicable law or agreed to in writing, software        *
+ * distributed under the License is distributed on an "AS IS" BASIS,          *
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.   *
+ * See the License for the specific language governing permissions and        *
+ * limitations under the License.                                             *
+ *                                                                            *
+ ******************************************************************************/
+
+#include "or1kiss/or1k.h"
+
+#define OR1KISS_STATE_MAGIC   (0x4f52314b) // "OR1K"
+#define OR1KISS_STATE_VERSION (2)
+
+namespace or1kiss {
+
+void or1k::save_state(ostream& os) const {
+    serialize(os, (u32)OR1KISS_STATE_MAGIC);
+    serialize(os, (u32)OR1KISS_STATE_VERSION);
+
+    serialize(os, gpr);
+    serialize(os, m_shadow);
+
+    serialize(os, m_instructions);
+    serialize(os, m_cycles);
+    serialize(os, m_sleep_cycles);
+
+    serialize(os, m_jump_target);
+    serialize(os, m_jump_insn);
+    serialize(os, m_prev_pc);
+    serialize(os, m_next_pc);
+
+    serialize(os, m_status);
+    serialize(os, m_fpcfg);
+    serialize(os, m_aecr);
+    serialize(os, m_aesr);
+    serialize(os, m_exsr);
+    serialize(os, m_expc);
+    serialize(os, m_exea);
+    serialize(os, m_evba);
+
+    serialize(os, m_mac);
+    serialize(os, m_fmac);
+
+    serialize(os, m_pmr);
+    serialize(os, m_pic_level);
+    serialize(os, m_pic_mr);
+    serialize(os, m_pic_sr);
+
+    serialize(os, m_num_excl_read);
+    serialize(os, m_num_excl_write);
+    serialize(os, m_num_excl_failed);
+
+    m_tick.save_state(os);
+    m_dmmu.save_state(os);
+    m_immu.save_state(os);
+
+    if (!os)
+        OR1KISS_ERROR("error writing processor state");
+}
+
+void or1k::restore_state(istream& is, bool invalidate) {
+    u32 magic = 0, version = 0;
+    deserialize(is, magic);
+    deserialize(is, version);
+
+    if (magic != OR1KISS_STATE_MAGIC)
+        OR1KISS_ERROR("invalid processor state");
+    if (version != OR1KISS_STATE_VERSION)
+        OR1KISS_ERROR("unsupported processor state version %u", version);
+
+    deserialize(is, gpr);
+    deserialize(is, m_shadow);
+
+    deserialize(is, m_instructions);
+    deserialize(is, m_cycles);
+    deserialize(is, m_sleep_cycles);
+
+    deserialize(is, m_jump_target);
+    deserialize(is, m_jump_insn);
+    deserialize(is, m_prev_pc);
+    deserialize(is, m_next_pc);
+
+    deserialize(is, m_status);
+    deserialize(is, m_fpcfg);
+    deserialize(is, m_aecr);
+    deserialize(is, m_aesr);
+    deserialize(is, m_exsr);
+    deserialize(is, m_expc);
+    deserialize(is, m_exea);
+    deserialize(is, m_evba);
+
+    deserialize(is, m_mac);
+    deserialize(is, m_fmac);
+
+    deserialize(is, m_pmr);
+    deserialize(is, m_pic_level);
+    deserialize(is, m_pic_mr);
+    deserialize(is, m_pic_sr);
+
+    deserialize(is, m_num_excl_read);
+    deserialize(is, m_num_excl_write);
+    deserialize(is, m_num_excl_failed);
+
+    m_tick.restore_state(is);
+    m_dmmu.restore_state(is);
+    m_immu.restore_state(is);
+
+    if (!is)
+        OR1KISS_ERROR("error reading processor state");
+
+    // Memory contents have most likely changed underneath us, so cached
+    // instructions need to be thrown away, unless the caller knows better
+    // and invalidates only what has changed (see invalidate_decode_cache).
+    if (invalidate)
+        m_decode_cache.invalidate_all();
+
+    // Posted writes and interrupts belong to the state we are leaving behind
+    m_wcb_mask = 0;
+    m_pic_mailbox.store(0);
+
+    // Caches only hold timing state, start cold to keep runs reproducible
+    m_dcache.invalidate_all();
+    m_icache.invalidate_all();
+
+    // Cycles have jumped, move our own events along with them
+    m_events.schedule(m_poll_event, m_cycles + OR1KISS_PIC_POLL);
+    schedule_tick();
+
+    // Pacing restarts from the restored cycle count
+    if (m_realtime)
+        set_realtime();
+
+    m_phys_ipg = m_virt_ipg = -1;
+}
+
+void or1k::capture_snapshot() {
+    std::ostringstream os;
+    save_state(os);
+    m_snapshot = os.str();
+}
+
+void or1k::restore_snapshot(const vector<u64>& pages, u64 page_size) {
+    if (m_snapshot.empty())
+        OR1KISS_ERROR("no processor snapshot captured");
+
+    for (u64 page : pages)
+        invalidate_decode_cache(page * page_size, page_size);
+
+    std::istringstream is(m_snapshot);
+    restore_state(is, false);
+}
+
+} // namespace or1kiss
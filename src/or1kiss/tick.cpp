@@ -20,54 +20,80 @@
 
 namespace or1kiss {
 
-tick::tick(): m_done(false), m_ttmr(0), m_ttcr(0) {
+tick::tick(): m_done(false), m_ttmr(0), m_ttcr(0), m_base(0) {
 }
 
 tick::~tick() {
     /* Nothing to do */
 }
 
-void tick::update(u64 delta) {
+u32 tick::get_ttcr(u64 now) const {
+    if (!running() || now < expiry())
+        return counter(now);
+
+    // The counter has expired, but nobody called update yet
+    tick tmp(*this);
+    tmp.update(now);
+    return tmp.counter(now);
+}
+
+void tick::set_ttmr(u32 v, u64 now) {
+    update(now);
+    m_ttcr = counter(now);
+    m_base = now;
+    m_ttmr = v;
+}
+
+void tick::set_ttcr(u32 v, u64 now) {
+    update(now);
+    m_ttcr = v;
+    m_base = now;
+    m_done = false;
+}
+
+void tick::update(u64 now) {
+    // TTCR is derived from the cycle counter, we only need to step in
+    // once it hits the limit. Catch up on all expiries until now.
     timer_mode mode = static_cast<timer_mode>(m_ttmr & 0xc0000000);
-    if (mode == TM_D || m_done)
-        return;
-
-    u64 lim = limit();
-    u64 cur = current();
-
-    bool irq_enabled = m_ttmr & TM_IE;
-    bool irq_set     = false;
-
-    switch (mode) {
-    case TM_RS:
-        if (cur < lim && cur + delta >= lim) {
-            irq_set = true;
-            m_ttcr  = 0;
-        } else {
-            m_ttcr += delta;
-        }
-        break;
-
-    case TM_OS:
-        if (cur < lim && cur + delta >= lim) {
-            m_done = irq_set = true;
-            m_ttcr           = lim;
-        } else {
-            m_ttcr += delta;
-        }
-        break;
+    while (running() && now >= expiry()) {
+        u64 at = expiry();
+
+        switch (mode) {
+        case TM_RS:
+            m_ttcr = 0;
+            break;
+
+        case TM_OS:
+            m_ttcr = limit();
+            m_done = true;
+            break;
+
+        case TM_CT:
+            m_ttcr += (u32)(at - m_base);
+            break;
 
-    case TM_CT:
-        irq_set = cur < lim && cur + delta >= lim;
-        m_ttcr += delta;
-        break;
+        default:
+            OR1KISS_ERROR("Invalid tick timer mode (%d)", mode);
+        }
 
-    default:
-        OR1KISS_ERROR("Invalid tick timer mode (%d)", mode);
+        m_base = at;
+        if (irq_enabled())
+            m_ttmr |= TM_IP;
     }
+}
+
+void tick::save_state(ostream& os) const {
+    serialize(os, m_done);
+    serialize(os, m_ttmr);
+    serialize(os, m_ttcr);
+    serialize(os, m_base);
+}
 
-    if (irq_enabled && irq_set)
-        m_ttmr |= TM_IP;
+void tick::restore_state(istream& is) {
+    deserialize(is, m_done);
+    deserialize(is, m_ttmr);
+    deserialize(is, m_ttcr);
+    deserialize(is, m_base);
 }
 
 } // namespace or1kiss
@@ -0,0 +1,151 @@
+/******************************************************************************
+ *                                                                            *
+ * Copyright 2018 Jan Henrik Weinstock                                        *
+ *                                                                            *
+ * Licensed under the Apache License, Version 2.0 (the "License");            *
+ * you may not use this file except in compliance with the License.           *
+ * You may obtain a copy of the License at                                    *
+ *                                                                            *
+ *     http://www.apache.org/licenses/LICENSE-2.0                             *
+ *                                                                            *
+ * Unless required by applicable law or agreed to in writing, software        *
+ * distributed under the License is distributed on an "AS IS" BASIS,          *
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.   *
+ * See the License for the specific language governing permissions and        *
+ * limitations under the License.                                             *
+ *                                                                            *
+ ******************************************************************************/
+
+#include "pool.h"
+
+// Identifies the pool and worker index of the current host thread
+static thread_local pool* g_pool = NULL;
+static thread_local unsigned int g_worker = 0;
+
+pool::pool(unsigned int nthreads):
+    m_queues(),
+    m_threads(),
+    m_mutex(),
+    m_work(),
+    m_idle(),
+    m_queued(0),
+    m_pending(0),
+    m_next(0),
+    m_stop(false),
+    m_error() {
+    if (nthreads == 0)
+        OR1KISS_ERROR("pool needs at least one thread");
+
+    for (unsigned int i = 0; i < nthreads; i++)
+        m_queues.emplace_back(new queue);
+    for (unsigned int i = 0; i < nthreads; i++)
+        m_threads.emplace_back(&pool::work, this, i);
+}
+
+pool::~pool() {
+    {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        m_stop = true;
+    }
+
+    m_work.notify_all();
+    for (std::thread& t : m_threads)
+        t.join();
+}
+
+void pool::submit(const task& t) {
+    unsigned int id;
+    if (g_pool == this) {
+        id = g_worker;
+    } else {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        id = m_next++ % m_queues.size();
+    }
+
+    submit(id, t);
+}
+
+void pool::submit(unsigned int worker, const task& t) {
+    unsigned int id = worker % m_queues.size();
+    {
+        std::lock_guard<std::mutex> guard(m_queues[id]->lock);
+        m_queues[id]->tasks.push_back(t);
+    }
+
+    {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        m_queued++;
+        m_pending++;
+    }
+
+    m_work.notify_one();
+}
+
+void pool::wait() {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_idle.wait(lock, [&] { return m_pending == 0; });
+
+    if (m_error) {
+        std::exception_ptr error = m_error;
+        m_error = nullptr;
+        std::rethrow_exception(error);
+    }
+}
+
+bool pool::take(unsigned int worker, task& t) {
+    size_t n = m_queues.size();
+    for (size_t i = 0; i < n; i++) {
+        queue& q = *m_queues[(worker + i) % n];
+        std::lock_guard<std::mutex> guard(q.lock);
+        if (q.tasks.empty())
+            continue;
+
+        // Our own queue is worked off in order, stealing happens from the
+        // back, where the most recently submitted tasks are.
+        if (i == 0) {
+            t = std::move(q.tasks.front());
+            q.tasks.pop_front();
+        } else {
+            t = std::move(q.tasks.back());
+            q.tasks.pop_back();
+        }
+
+        return true;
+    }
+
+    return false;
+}
+
+void pool::work(unsigned int worker) {
+    g_pool   = this;
+    g_worker = worker;
+
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_work.wait(lock, [&] { return m_stop || m_queued > 0; });
+            if (m_queued == 0)
+                return;
+
+            // Claim one task, it is ours even if someone steals the one we
+            // find first, because we will then find another one.
+            m_queued--;
+        }
+
+        task t;
+        while (!take(worker, t))
+            std::this_thread::yield();
+
+        try {
+            t(worker);
+        } catch (...) {
+            std::lock_guard<std::mutex> guard(m_mutex);
+            if (!m_error)
+                m_error = std::current_exception();
+        }
+
+        std::lock_guard<std::mutex> guard(m_mutex);
+        if (--m_pending == 0)
+            m_idle.notify_all();
+    }
+}
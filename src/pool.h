@@ -0,0 +1,80 @@
+/******************************************************************************
+ *                                                                            *
+ * Copyright 2018 Jan Henrik Weinstock                                        *
+ *                                                                            *
+ * Licensed under the Apache License, Version 2.0 (the "License");            *
+ * you may not use this file except in compliance with the License.           *
+ * You may obtain a copy of the License at                                    *
+ *                                                                            *
+ *     http://www.apache.org/licenses/LICENSE-2.0                             *
+ *                                                                            *
+ * Unless required by applicable law or agreed to in writing, software        *
+ * distributed under the License is distributed on an "AS IS" BASIS,          *
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.   *
+ * See the License for the specific language governing permissions and        *
+ * limitations under the License.                                             *
+ *                                                                            *
+ ******************************************************************************/
+
+#ifndef POOL_H
+#define POOL_H
+
+#include <deque>
+#include <vector>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <exception>
+
+#include "or1kiss.h"
+
+// Thread pool with one task queue per worker. Workers take tasks from the
+// front of their own queue and steal from the back of the others once
+// theirs runs dry. Tasks receive the index of the worker running them, so
+// that callers can keep expensive per-worker resources around and reuse
+// them across tasks. Tasks submitted from within a worker go to the queue
+// of that worker, unless a specific worker is requested.
+class pool
+{
+public:
+    typedef std::function<void(unsigned int worker)> task;
+
+private:
+    struct queue {
+        std::mutex lock;
+        std::deque<task> tasks;
+    };
+
+    std::vector<std::unique_ptr<queue>> m_queues;
+    std::vector<std::thread> m_threads;
+
+    std::mutex m_mutex;
+    std::condition_variable m_work;
+    std::condition_variable m_idle;
+    size_t m_queued;  // tasks waiting in any queue
+    size_t m_pending; // tasks submitted but not finished yet
+    unsigned int m_next;
+    bool m_stop;
+    std::exception_ptr m_error;
+
+    bool take(unsigned int worker, task& t);
+    void work(unsigned int worker);
+
+    // Disabled
+    pool();
+    pool(const pool&);
+
+public:
+    unsigned int size() const { return m_threads.size(); }
+
+    pool(unsigned int nthreads);
+    virtual ~pool();
+
+    void submit(const task& t);
+    void submit(unsigned int worker, const task& t);
+    void wait();
+};
+
+#endif
@@ -0,0 +1,155 @@
+/******************************************************************************
+ *                                                                            *
+ * Copyright 2018 Jan Henrik Weinstock                                        *
+ *                                                                            *
+ * Licensed under the Apache License, Version 2.0 (the "License");            *
+ * you may not use this file except in compliance with the License.           *
+ * You may obtain a copy of the License at                                    *
+ *                                                                            *
+ *     http://www.apache.org/licenses/LICENSE-2.0                             *
+ *                                                                            *
+ * Unless required by applicable law or agreed to in writing, software        *
+ * distributed under the License is distributed on an "AS IS" BASIS,          *
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.   *
+ * See the License for the specific language governing permissions and        *
+ * limitations under the License.                                             *
+ *                                                                            *
+ ******************************************************************************/
+
+#include <poll.h>
+#include <signal.h>
+#include <sys/wait.h>
+
+#include "sweep.h"
+
+sweep::sweep(unsigned int n):
+    m_params(),
+    m_children(),
+    m_index(-1) {
+    for (unsigned int i = 0; i < n; i++)
+        m_params.push_back(i);
+}
+
+sweep::sweep(const std::vector<uint32_t>& params):
+    m_params(params),
+    m_children(),
+    m_index(-1) {
+    // nothing to do
+}
+
+sweep::~sweep() {
+    for (child& c : m_children) {
+        if (c.fd >= 0)
+            close(c.fd);
+    }
+}
+
+void sweep::collect() {
+    std::vector<struct pollfd> pfds;
+    for (const child& c : m_children)
+        pfds.push_back({ c.fd, POLLIN, 0 });
+
+    size_t open = pfds.size();
+    while (open > 0) {
+        if (poll(pfds.data(), pfds.size(), -1) < 0) {
+            if (errno == EINTR)
+                continue;
+            OR1KISS_ERROR("poll failed: %s", strerror(errno));
+        }
+
+        for (size_t i = 0; i < pfds.size(); i++) {
+            if (pfds[i].fd < 0 || pfds[i].revents == 0)
+                continue;
+
+            char buffer[4096];
+            ssize_t n = read(pfds[i].fd, buffer, sizeof(buffer));
+            if (n < 0 && errno == EINTR)
+                continue;
+
+            if (n > 0) {
+                m_children[i].output.append(buffer, n);
+            } else {
+                close(pfds[i].fd);
+                m_children[i].fd = pfds[i].fd = -1;
+                open--;
+            }
+        }
+    }
+
+    for (child& c : m_children) {
+        while (waitpid(c.pid, &c.status, 0) < 0) {
+            if (errno != EINTR)
+                OR1KISS_ERROR("waitpid failed: %s", strerror(errno));
+        }
+    }
+}
+
+bool sweep::fork(or1kiss::or1k& core, bool setregs) {
+    // Anything still buffered would otherwise be printed by every child
+    fflush(stdout);
+    fflush(stderr);
+
+    for (size_t i = 0; i < m_params.size(); i++) {
+        int fds[2];
+        if (pipe(fds) < 0)
+            OR1KISS_ERROR("failed to create pipe: %s", strerror(errno));
+
+        pid_t pid = ::fork();
+        if (pid < 0)
+            OR1KISS_ERROR("failed to fork: %s", strerror(errno));
+
+        if (pid == 0) {
+            for (const child& c : m_children)
+                close(c.fd);
+            m_children.clear();
+
+            close(fds[0]);
+            dup2(fds[1], STDOUT_FILENO);
+            dup2(fds[1], STDERR_FILENO);
+            close(fds[1]);
+
+            // glibc treats seeds 0 and 1 alike, so start counting at 1
+            m_index = i;
+            srand(i + 1);
+
+            if (setregs) {
+                core.gpr[11] = i;
+                core.gpr[12] = m_params[i];
+            }
+
+            // Further NOP_ROI are plain nops inside the children
+            core.enable_roi(false);
+            return true;
+        }
+
+        close(fds[1]);
+        m_children.push_back({ pid, fds[0], 0, "" });
+    }
+
+    collect();
+    return false;
+}
+
+unsigned int sweep::report() const {
+    unsigned int failed = 0;
+    for (size_t i = 0; i < m_children.size(); i++) {
+        const child& c = m_children[i];
+        std::string result;
+        if (WIFEXITED(c.status)) {
+            result = "exit status " + std::to_string(WEXITSTATUS(c.status));
+        } else if (WIFSIGNALED(c.status)) {
+            result = "killed by " + std::string(strsignal(WTERMSIG(c.status)));
+        }
+
+        bool success = WIFEXITED(c.status) && !WEXITSTATUS(c.status);
+        if (!success)
+            failed++;
+
+        printf("# child %-7zu: param 0x%08x, %s\n", i, m_params[i],
+               result.c_str());
+        fwrite(c.output.data(), 1, c.output.size(), stdout);
+    }
+
+    printf("# children     : %zu, %u failed\n", m_children.size(), failed);
+    return failed;
+}
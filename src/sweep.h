@@ -0,0 +1,75 @@
+/******************************************************************************
+ *                                                                            *
+ * Copyright 2018 Jan Henrik Weinstock                                        *
+ *                                                                            *
+ * Licensed under the Apache License, Version 2.0 (the "License");            *
+ * you may not use this file except in compliance with the License.           *
+ * You may obtain a copy of the License at                                    *
+ *                                                                            *
+ *     http://www.apache.org/licenses/LICENSE-2.0                             *
+ *                                                                            *
+ * Unless required by applicable law or agreed to in writing, software        *
+ * distributed under the License is distributed on an "AS IS" BASIS,          *
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.   *
+ * See the License for the specific language governing permissions and        *
+ * limitations under the License.                                             *
+ *                                                                            *
+ ******************************************************************************/
+
+#ifndef SWEEP_H
+#define SWEEP_H
+
+#include <string>
+#include <vector>
+#include <sys/types.h>
+
+#include "or1kiss.h"
+
+// Explores several continuations of one simulation. Once the region of
+// interest is reached, the simulator forks a child process per parameter
+// and each child carries on from the very same state, sharing guest memory
+// and the decode cache with its siblings until it writes to them. Children
+// get their index in r11 and their parameter in r12 (when started from
+// NOP_ROI) and seed the host random number generator based on their index,
+// so NOP_RANDOM takes a different path in each of them. Their console output
+// is collected by the parent and printed in order once all have finished.
+class sweep
+{
+private:
+    struct child {
+        pid_t pid;
+        int fd;
+        int status;
+        std::string output;
+    };
+
+    std::vector<uint32_t> m_params;
+    std::vector<child> m_children;
+    int m_index;
+
+    void collect();
+
+    // Disabled
+    sweep();
+    sweep(const sweep&);
+
+public:
+    size_t get_num_children() const { return m_params.size(); }
+    int get_index() const { return m_index; }
+
+    bool is_parent() const { return !m_children.empty(); }
+    bool is_child() const { return m_index >= 0; }
+
+    sweep(unsigned int n);
+    sweep(const std::vector<uint32_t>& params);
+    virtual ~sweep();
+
+    // Forks all children, returns true inside the children, which continue
+    // the simulation, and false in the parent once all children are done.
+    bool fork(or1kiss::or1k& core, bool setregs);
+
+    // Prints what the children reported, returns the number that failed.
+    unsigned int report() const;
+};
+
+#endif
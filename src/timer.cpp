@@ -0,0 +1,137 @@
+/******************************************************************************
+ *                                                                            *
+ * Copyright 2018 Jan Henrik Weinstock                                        *
+ *                                                                            *
+ * Licensed under the Apache License, Version 2.0 (the "License");            *
+ * you may not use this file except in compliance with the License.           *
+ * You may obtain a copy of the License at                                    *
+ *                                                                            *
+ *     http://www.apache.org/licenses/LICENSE-2.0                             *
+ *                                                                            *
+ * Unless required by applicable law or agreed to in writing, software        *
+ * distributed under the License is distributed on an "AS IS" BASIS,          *
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.   *
+ * See the License for the specific language governing permissions and        *
+ * limitations under the License.                                             *
+ *                                                                            *
+ ******************************************************************************/
+
+#include "timer.h"
+
+#define TIMER_SIZE (16)
+
+enum timer_regs {
+    TIMER_CTRL    = 0x0,
+    TIMER_STATUS  = 0x4,
+    TIMER_COUNT   = 0x8,
+    TIMER_COMPARE = 0xc,
+};
+
+enum timer_bits {
+    CTRL_EN  = 1 << 0, // timer enabled
+    CTRL_IE  = 1 << 1, // interrupt enabled
+    CTRL_PER = 1 << 2, // periodic mode
+
+    STATUS_IP = 1 << 0, // interrupt pending
+};
+
+uint32_t timer::get_count() const {
+    if (!(m_ctrl & CTRL_EN))
+        return m_count;
+    return m_count + (uint32_t)(get_cycles() - m_cycles);
+}
+
+void timer::set_count(uint32_t count) {
+    m_count  = count;
+    m_cycles = get_cycles();
+}
+
+timer::timer(const std::string& name, uint32_t base, uint64_t latency):
+    device(name, base, TIMER_SIZE, latency),
+    m_ctrl(0),
+    m_status(0),
+    m_compare(0),
+    m_count(0),
+    m_cycles(0) {
+    /* Nothing to do */
+}
+
+timer::~timer() {
+    /* Nothing to do */
+}
+
+or1kiss::response timer::read(uint32_t offset, unsigned char* data,
+                              uint32_t size) {
+    if ((size != 4) || (offset & 3))
+        return or1kiss::RESP_ERROR;
+
+    switch (offset) {
+    case TIMER_CTRL:
+        store_value(data, size, m_ctrl);
+        break;
+
+    case TIMER_STATUS:
+        store_value(data, size, m_status);
+        break;
+
+    case TIMER_COUNT:
+        store_value(data, size, get_count());
+        break;
+
+    case TIMER_COMPARE:
+        store_value(data, size, m_compare);
+        break;
+
+    default:
+        return or1kiss::RESP_ERROR;
+    }
+
+    return or1kiss::RESP_SUCCESS;
+}
+
+or1kiss::response timer::write(uint32_t offset, const unsigned char* data,
+                               uint32_t size) {
+    if ((size != 4) || (offset & 3))
+        return or1kiss::RESP_ERROR;
+
+    uint32_t val = load_value(data, size);
+
+    switch (offset) {
+    case TIMER_CTRL:
+        set_count(get_count()); // freeze or restart counting from here
+        m_ctrl = val & (CTRL_EN | CTRL_IE | CTRL_PER);
+        break;
+
+    case TIMER_STATUS:
+        m_status &= ~(val & STATUS_IP);
+        break;
+
+    case TIMER_COUNT:
+        set_count(val);
+        break;
+
+    case TIMER_COMPARE:
+        m_compare = val;
+        break;
+
+    default:
+        return or1kiss::RESP_ERROR;
+    }
+
+    update();
+    return or1kiss::RESP_SUCCESS;
+}
+
+void timer::update() {
+    if ((m_ctrl & CTRL_EN) && (get_count() >= m_compare)) {
+        m_status |= STATUS_IP;
+        if (m_ctrl & CTRL_PER) {
+            set_count(get_count() - m_compare);
+        } else {
+            set_count(get_count());
+            m_ctrl &= ~CTRL_EN;
+        }
+    }
+
+    interrupt((m_ctrl & CTRL_IE) && (m_status & STATUS_IP));
+}
@@ -0,0 +1,60 @@
+/******************************************************************************
+ *                                                                            *
+ * Copyright 2018 Jan Henrik Weinstock                                        *
+ *                                                                            *
+ * Licensed under the Apache License, Version 2.0 (the "License");            *
+ * you may not use this file except in compliance with the License.           *
+ * You may obtain a copy of the License at                                    *
+ *                                                                            *
+ *     http://www.apache.org/licenses/LICENSE-2.0                             *
+ *                                                                            *
+ * Unless required by applicable law or agreed to in writing, software        *
+ * distributed under the License is distributed on an "AS IS" BASIS,          *
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.   *
+ * See the License for the specific language governing permissions and        *
+ * limitations under the License.                                             *
+ *                                                                            *
+ ******************************************************************************/
+
+#ifndef TIMER_H
+#define TIMER_H
+
+#include "device.h"
+
+// Simple 32bit timer counting processor cycles. It raises its interrupt
+// once the counter reaches the compare value and then either stops or, in
+// periodic mode, restarts counting from zero. Compare matches are noticed
+// in update(), i.e. at quantum granularity. The event queue of the core is
+// not used: any core may write these registers, but a queue is only safe
+// to use from the thread simulating its core. Registers (32bit each):
+//   0x0 CTRL    enable (bit 0), interrupt enable (bit 1), periodic (bit 2)
+//   0x4 STATUS  interrupt pending (bit 0), write 1 to clear
+//   0x8 COUNT   current counter value
+//   0xc COMPARE counter value that triggers the interrupt
+class timer : public device
+{
+private:
+    uint32_t m_ctrl;
+    uint32_t m_status;
+    uint32_t m_compare;
+
+    uint32_t m_count;  // counter value at m_cycles
+    uint64_t m_cycles; // cycle count when m_count was last updated
+
+    uint32_t get_count() const;
+    void set_count(uint32_t count);
+
+public:
+    timer(const std::string& name, uint32_t base, uint64_t latency = 1);
+    virtual ~timer();
+
+    virtual or1kiss::response read(uint32_t offset, unsigned char* data,
+                                   uint32_t size);
+    virtual or1kiss::response write(uint32_t offset,
+                                    const unsigned char* data,
+                                    uint32_t size);
+
+    virtual void update();
+};
+
+#endif
@@ -0,0 +1,249 @@
+/******************************************************************************
+ *                                                                            *
+ * Copyright 2018 Jan Henrik Weinstock                                        *
+ *                                                                            *
+ * Licensed under the Apache License, Version 2.0 (the "License");            *
+ * you may not use this file except in compliance with the License.           *
+ * You may obtain a copy of the License at                                    *
+ *                                                                            *
+ *     http://www.apache.org/licenses/LICENSE-2.0                             *
+ *                                                                            *
+ * Unless required by applicable law or agreed to in writing, software        *
+ * distributed under the License is distributed on an "AS IS" BASIS,          *
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.   *
+ * See the License for the specific language governing permissions and        *
+ * limitations under the License.                                             *
+ *                                                                            *
+ ******************************************************************************/
+
+#include <poll.h>
+
+#include "uart.h"
+
+#define UART_SIZE (8)
+
+enum uart_regs {
+    UART_RBR = 0, // receive buffer (read), transmit holding (write)
+    UART_IER = 1, // interrupt enable
+    UART_IIR = 2, // interrupt identification (read), fifo control (write)
+    UART_LCR = 3, // line control
+    UART_MCR = 4, // modem control
+    UART_LSR = 5, // line status
+    UART_MSR = 6, // modem status
+    UART_SCR = 7, // scratch
+};
+
+enum uart_bits {
+    IER_RDI  = 1 << 0, // receive data interrupt
+    IER_THRI = 1 << 1, // transmitter holding register empty interrupt
+
+    IIR_NONE = 0x01, // no interrupt pending
+    IIR_THRI = 0x02, // transmitter holding register empty
+    IIR_RDI  = 0x04, // receive data available
+    IIR_FIFO = 0xc0, // fifos enabled
+
+    FCR_FIFO   = 1 << 0, // enable fifos
+    FCR_CLR_RX = 1 << 1, // clear receive fifo
+
+    LCR_DLAB = 1 << 7, // divisor latch access
+
+    LSR_DR   = 1 << 0, // data ready
+    LSR_THRE = 1 << 5, // transmitter holding register empty
+    LSR_TEMT = 1 << 6, // transmitter empty
+
+    MSR_DCD = 1 << 7, // data carrier detect
+    MSR_DSR = 1 << 5, // data set ready
+    MSR_CTS = 1 << 4, // clear to send
+};
+
+uint8_t uart::read_iir() {
+    uint8_t fifo = m_fifo ? IIR_FIFO : 0;
+
+    if ((m_ier & IER_RDI) && !m_rx.empty())
+        return fifo | IIR_RDI;
+
+    // Reading IIR acknowledges the transmitter empty interrupt
+    if ((m_ier & IER_THRI) && m_thr_empty) {
+        m_thr_empty = false;
+        update_irq();
+        return fifo | IIR_THRI;
+    }
+
+    return fifo | IIR_NONE;
+}
+
+uint8_t uart::read_lsr() const {
+    uint8_t lsr = LSR_THRE | LSR_TEMT; // we transmit immediately
+    if (!m_rx.empty())
+        lsr |= LSR_DR;
+    return lsr;
+}
+
+void uart::poll_rx() {
+    if (!m_rx_enabled)
+        return;
+
+    struct pollfd pfd = { STDIN_FILENO, POLLIN, 0 };
+    while (poll(&pfd, 1, 0) > 0 && (pfd.revents & POLLIN)) {
+        unsigned char c;
+        if (::read(STDIN_FILENO, &c, 1) != 1) {
+            m_rx_enabled = false; // EOF or error, stop polling
+            break;
+        }
+
+        m_rx.push_back(c);
+    }
+}
+
+void uart::update_irq() {
+    bool rdi  = (m_ier & IER_RDI) && !m_rx.empty();
+    bool thri = (m_ier & IER_THRI) && m_thr_empty;
+    interrupt(rdi || thri);
+}
+
+uart::uart(const std::string& name, uint32_t base, uint64_t latency):
+    device(name, base, UART_SIZE, latency),
+    m_rx(),
+    m_ier(0),
+    m_lcr(0),
+    m_mcr(0),
+    m_scr(0),
+    m_dll(0),
+    m_dlm(0),
+    m_fifo(false),
+    m_thr_empty(false),
+    m_rx_enabled(true),
+    m_output(NULL) {
+    /* Nothing to do */
+}
+
+uart::~uart() {
+    /* Nothing to do */
+}
+
+or1kiss::response uart::read(uint32_t offset, unsigned char* data,
+                             uint32_t size) {
+    if (size != 1)
+        return or1kiss::RESP_ERROR;
+
+    bool dlab = m_lcr & LCR_DLAB;
+
+    switch (offset) {
+    case UART_RBR:
+        if (dlab) {
+            *data = m_dll;
+        } else {
+            *data = m_rx.empty() ? 0 : m_rx.front();
+            if (!m_rx.empty())
+                m_rx.pop_front();
+            update_irq();
+        }
+        break;
+
+    case UART_IER:
+        *data = dlab ? m_dlm : m_ier;
+        break;
+
+    case UART_IIR:
+        *data = read_iir();
+        break;
+
+    case UART_LCR:
+        *data = m_lcr;
+        break;
+
+    case UART_MCR:
+        *data = m_mcr;
+        break;
+
+    case UART_LSR:
+        *data = read_lsr();
+        break;
+
+    case UART_MSR:
+        *data = MSR_DCD | MSR_DSR | MSR_CTS;
+        break;
+
+    case UART_SCR:
+        *data = m_scr;
+        break;
+
+    default:
+        return or1kiss::RESP_ERROR;
+    }
+
+    return or1kiss::RESP_SUCCESS;
+}
+
+or1kiss::response uart::write(uint32_t offset, const unsigned char* data,
+                              uint32_t size) {
+    if (size != 1)
+        return or1kiss::RESP_ERROR;
+
+    bool dlab = m_lcr & LCR_DLAB;
+
+    switch (offset) {
+    case UART_RBR:
+        if (dlab) {
+            m_dll = *data;
+        } else {
+            if (m_output) {
+                m_output->put(*data);
+            } else {
+                putchar(*data);
+                fflush(stdout);
+            }
+            m_thr_empty = true;
+            update_irq();
+        }
+        break;
+
+    case UART_IER:
+        if (dlab) {
+            m_dlm = *data;
+        } else {
+            // Enabling the transmit interrupt fires right away, since we
+            // are always ready to send.
+            if (!(m_ier & IER_THRI) && (*data & IER_THRI))
+                m_thr_empty = true;
+            m_ier = *data & 0x0f;
+            update_irq();
+        }
+        break;
+
+    case UART_IIR:
+        m_fifo = *data & FCR_FIFO;
+        if (*data & FCR_CLR_RX)
+            m_rx.clear();
+        update_irq();
+        break;
+
+    case UART_LCR:
+        m_lcr = *data;
+        break;
+
+    case UART_MCR:
+        m_mcr = *data;
+        break;
+
+    case UART_LSR:
+    case UART_MSR:
+        break; // read-only
+
+    case UART_SCR:
+        m_scr = *data;
+        break;
+
+    default:
+        return or1kiss::RESP_ERROR;
+    }
+
+    return or1kiss::RESP_SUCCESS;
+}
+
+void uart::update() {
+    size_t pending = m_rx.size();
+    poll_rx();
+    if (m_rx.size() != pending)
+        update_irq();
+}
@@ -0,0 +1,74 @@
+/******************************************************************************
+ *                                                                            *
+ * Copyright 2018 Jan Henrik Weinstock                                        *
+ *                                                                            *
+ * Licensed under the Apache License, Version 2.0 (the "License");            *
+ * you may not use this file except in compliance with the License.           *
+ * You may obtain a copy of the License at                                    *
+ *                                                                            *
+ *     http://www.apache.org/licenses/LICENSE-2.0                             *
+ *                                                                            *
+ * Unless required by applicable law or agreed to in writing, software        *
+ * distributed under the License is distributed on an "AS IS" BASIS,          *
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.   *
+ * See the License for the specific language governing permissions and        *
+ * limitations under the License.                                             *
+ *                                                                            *
+ ******************************************************************************/
+
+#ifndef UART_H
+#define UART_H
+
+#include <deque>
+#include <ostream>
+
+#include "device.h"
+
+// Minimal 16550 compatible UART: transmitted characters go to stdout and
+// characters available on stdin are received. Baud rate and line settings
+// are stored but have no effect.
+class uart : public device
+{
+private:
+    std::deque<unsigned char> m_rx;
+
+    uint8_t m_ier;
+    uint8_t m_lcr;
+    uint8_t m_mcr;
+    uint8_t m_scr;
+    uint8_t m_dll;
+    uint8_t m_dlm;
+
+    bool m_fifo;
+    bool m_thr_empty; // transmitter empty interrupt pending
+    bool m_rx_enabled;
+
+    std::ostream* m_output; // NULL means stdout
+
+    uint8_t read_iir();
+    uint8_t read_lsr() const;
+
+    void poll_rx();
+    void update_irq();
+
+public:
+    uart(const std::string& name, uint32_t base, uint64_t latency = 1);
+    virtual ~uart();
+
+    // Capture transmitted characters, e.g. per batch job, and stop
+    // receiving from stdin, which is shared by everyone in the process.
+    void redirect(std::ostream& os) {
+        m_output     = &os;
+        m_rx_enabled = false;
+    }
+
+    virtual or1kiss::response read(uint32_t offset, unsigned char* data,
+                                   uint32_t size);
+    virtual or1kiss::response write(uint32_t offset,
+                                    const unsigned char* data,
+                                    uint32_t size);
+
+    virtual void update();
+};
+
+#endif